@@ -0,0 +1,345 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "BVHBuilder.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include "Parallel.h"
+
+BVHSettings::BVHSettings() {
+    splitMethod = MiddleSplit;
+    width = DefaultBVHWidth;
+    traversalCost = 1.;
+    intersectionCost = 1.;
+    numberOfBins = 16;
+    minLeafSize = 5;
+    maxLeafSize = 16;
+    numberOfThreads = 0;
+    parallelSubtreeSize = 4096;
+    parallelBinningSize = 1 << 17;
+};
+
+BVHStatistics::BVHStatistics() : numberOfNodes(0), numberOfLeaves(0), maxDepth(0), sahCost(0), buildTime(0), primitivesPerSecond(0) {};
+
+BVHBuilder::BVHBuilder(const BVHSettings& settings, const std::vector<BoundingBox>& bounds, const std::vector<Vector>& centroids)
+        : settings(settings), bounds(bounds), centroids(centroids), activeThreads(0) {
+    numberOfThreads = resolveThreadCount(settings.numberOfThreads);
+};
+
+/**
+ * Build the BVH and flatten it in depth-first order.
+ *
+ * Large subtrees are built on their own threads and the top-level nodes are binned by all threads
+ * together. The result does not depend on the number of threads.
+ *
+ * @param nodes flattened BVH, leaves reference ranges of order
+ * @param order primitive stored at every position, i.e. the primitives have to be permuted by order
+ * @param statistics size, SAH cost and build time of the BVH
+ */
+void BVHBuilder::build(std::vector<LinearNode>& nodes, std::vector<int>& order, BVHStatistics& statistics) {
+    auto start = std::chrono::steady_clock::now();
+    statistics = BVHStatistics();
+    nodes.clear();
+    this->order.resize(bounds.size());
+    std::iota(this->order.begin(), this->order.end(), 0);
+
+    if (!bounds.empty()) {
+        Node root;
+        buildNode(&root, 0, bounds.size(), 0);
+        nodes.reserve(2*bounds.size());
+        flatten(&root, nodes, 0, statistics);
+        nodes.shrink_to_fit();
+        statistics.sahCost = computeSAHCost(nodes, settings.traversalCost, settings.intersectionCost);
+    }
+
+    order.swap(this->order);
+    statistics.buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (statistics.buildTime > 0) {
+        statistics.primitivesPerSecond = bounds.size() / statistics.buildTime;
+    }
+}
+
+/**
+ * Claim up to wanted of the build threads which are not busy, for a subtree or a parallel loop.
+ *
+ * Subtree builds and the loops they run share the budget of numberOfThreads, so nested parallelism never
+ * starts more threads than that.
+ *
+ * @return number of threads claimed, they have to be released by subtracting it from activeThreads
+ */
+int BVHBuilder::reserveThreads(int wanted) {
+    int active = activeThreads.load();
+    while (true) {
+        int granted = std::min(wanted, numberOfThreads - 1 - active);
+        if (granted <= 0) return 0;
+        if (activeThreads.compare_exchange_weak(active, active + granted)) {
+            return granted;
+        }
+    }
+}
+
+/**
+ * Compute the bounds of the primitives and of the centroids in a range.
+ */
+void BVHBuilder::computeBounds(Node* n, int beginning, int end, BoundingBox& centroidBounds) {
+    int extraThreads = end - beginning < settings.parallelBinningSize ? 0 : reserveThreads(numberOfThreads - 1);
+    if (extraThreads == 0) {
+        for (int i = beginning; i < end; i++) {
+            n->b.extend(bounds[order[i]]);
+            centroidBounds.extend(centroids[order[i]]);
+        }
+        return;
+    }
+
+    std::vector<BoundingBox> chunkBounds(extraThreads + 1), chunkCentroidBounds(extraThreads + 1);
+    int chunks = parallelFor(beginning, end, extraThreads + 1, [&](int chunkBeginning, int chunkEnd, int chunk) {
+        for (int i = chunkBeginning; i < chunkEnd; i++) {
+            chunkBounds[chunk].extend(bounds[order[i]]);
+            chunkCentroidBounds[chunk].extend(centroids[order[i]]);
+        }
+    });
+    activeThreads -= extraThreads;
+    for (int c = 0; c < chunks; c++) {
+        n->b.extend(chunkBounds[c]);
+        centroidBounds.extend(chunkCentroidBounds[c]);
+    }
+}
+
+void BVHBuilder::buildNode(Node* n, int beginning, int end, int depth) {
+    n->beginning = beginning;
+    n->end = end;
+    BoundingBox centroidBounds;
+    computeBounds(n, beginning, end, centroidBounds);
+
+    bool tooLargeForLeaf = end - beginning > std::numeric_limits<uint16_t>::max();
+    if (!tooLargeForLeaf && (end - beginning < settings.minLeafSize || depth >= MaxBVHDepth)) {
+        return;
+    }
+
+    int indicePivot;
+    if (depth >= MaxBVHDepth) {
+        // past the maximum depth only ranges too large for a leaf get here, halving them at the median
+        // bounds the extra levels to log2 of their size over the leaf capacity, which BVHStackSize leaves room for
+        n->axis = centroidBounds.longestAxis();
+        indicePivot = splitMedian(beginning, end, n->axis);
+    } else {
+        if (settings.splitMethod == SAHSplit) {
+            indicePivot = splitSAH(n, beginning, end, centroidBounds);
+        } else {
+            indicePivot = splitMiddle(n, beginning, end);
+        }
+        if (indicePivot == beginning || indicePivot == end) {
+            if (!tooLargeForLeaf) {
+                return;
+            }
+            // split in the middle of the range, a leaf cannot hold that many primitives
+            indicePivot = splitMedian(beginning, end, n->axis);
+        }
+    }
+
+    n->fg = new Node;
+    n->fd = new Node;
+
+    if (end - beginning >= settings.parallelSubtreeSize && reserveThreads(1) == 1) {
+        std::thread left([=]() {
+            buildNode(n->fg, beginning, indicePivot, depth + 1);
+            activeThreads--;
+        });
+        buildNode(n->fd, indicePivot, end, depth + 1);
+        left.join();
+    } else {
+        buildNode(n->fg, beginning, indicePivot, depth + 1);
+        buildNode(n->fd, indicePivot, end, depth + 1);
+    }
+}
+
+/**
+ * Partition the range into two halves of equal size along an axis.
+ *
+ * @return index of the first primitive of the second half
+ */
+int BVHBuilder::splitMedian(int beginning, int end, int dim) {
+    int indicePivot = (beginning + end) / 2;
+    std::nth_element(order.begin() + beginning, order.begin() + indicePivot, order.begin() + end,
+                     [&](int a, int b) { return centroids[a][dim] < centroids[b][dim]; });
+    return indicePivot;
+}
+
+/**
+ * Partition the range at the spatial middle of the longest axis of the node.
+ *
+ * @return index of the first primitive of the second child
+ */
+int BVHBuilder::splitMiddle(Node* n, int beginning, int end) {
+    int dim = n->b.longestAxis();
+    n->axis = dim;
+    double middle = (n->b.mini[dim] + n->b.maxi[dim])*0.5;
+    int indicePivot = beginning;
+    for (int i = beginning; i < end; i++) {
+        if (centroids[order[i]][dim] < middle) {
+            std::swap(order[i], order[indicePivot]);
+            indicePivot++;
+        }
+    }
+    return indicePivot;
+}
+
+/**
+ * Partition the range with the binned surface area heuristic.
+ *
+ * The centroids are sorted into numberOfBins bins along every axis and the split between two bins with
+ * the lowest expected cost is taken. If no split is cheaper than intersecting all primitives the range
+ * becomes a leaf, unless it holds more than maxLeafSize primitives.
+ *
+ * @return index of the first primitive of the second child, beginning if the node should be a leaf
+ */
+int BVHBuilder::splitSAH(Node* n, int beginning, int end, const BoundingBox& centroidBounds) {
+    int count = end - beginning;
+    int nBins = std::max(2, settings.numberOfBins);
+    double nodeArea = n->b.area();
+
+    double bestCost = std::numeric_limits<double>::max();
+    int bestAxis = -1, bestBin = -1;
+    n->axis = centroidBounds.longestAxis();
+
+    // bins of all three axes, filled in a single pass over the primitives
+    double scale[3];
+    for (int dim = 0; dim < 3; dim++) {
+        double extent = centroidBounds.maxi[dim] - centroidBounds.mini[dim];
+        scale[dim] = extent > 0 ? nBins / extent : 0;
+    }
+    auto fillBins = [&](int chunkBeginning, int chunkEnd, BoundingBox* binBounds, int* binCounts) {
+        for (int i = chunkBeginning; i < chunkEnd; i++) {
+            const Vector& c = centroids[order[i]];
+            const BoundingBox& b = bounds[order[i]];
+            for (int dim = 0; dim < 3; dim++) {
+                int bin = dim*nBins + std::min(nBins - 1, (int) ((c[dim] - centroidBounds.mini[dim]) * scale[dim]));
+                binCounts[bin]++;
+                binBounds[bin].extend(b);
+            }
+        }
+    };
+
+    std::vector<BoundingBox> binBounds(3*nBins);
+    std::vector<int> binCounts(3*nBins, 0);
+    int extraThreads = count < settings.parallelBinningSize ? 0 : reserveThreads(numberOfThreads - 1);
+    if (extraThreads == 0) {
+        fillBins(beginning, end, &binBounds[0], &binCounts[0]);
+    } else {
+        std::vector<BoundingBox> chunkBounds((extraThreads + 1)*3*nBins);
+        std::vector<int> chunkCounts((extraThreads + 1)*3*nBins, 0);
+        int chunks = parallelFor(beginning, end, extraThreads + 1, [&](int chunkBeginning, int chunkEnd, int chunk) {
+            fillBins(chunkBeginning, chunkEnd, &chunkBounds[chunk*3*nBins], &chunkCounts[chunk*3*nBins]);
+        });
+        activeThreads -= extraThreads;
+        for (int c = 0; c < chunks; c++) {
+            for (int bin = 0; bin < 3*nBins; bin++) {
+                binBounds[bin].extend(chunkBounds[c*3*nBins + bin]);
+                binCounts[bin] += chunkCounts[c*3*nBins + bin];
+            }
+        }
+    }
+
+    std::vector<BoundingBox> rightBounds(nBins);
+    for (int dim = 0; dim < 3; dim++) {
+        if (scale[dim] == 0) continue;
+        const BoundingBox* axisBounds = &binBounds[dim*nBins];
+        const int* axisCounts = &binCounts[dim*nBins];
+
+        // sweep from the right to get the bounds of every right-hand side
+        rightBounds[nBins - 1] = axisBounds[nBins - 1];
+        for (int b = nBins - 2; b >= 0; b--) {
+            rightBounds[b] = rightBounds[b + 1];
+            rightBounds[b].extend(axisBounds[b]);
+        }
+
+        // sweep from the left and evaluate the split after every bin
+        BoundingBox leftBounds;
+        int leftCount = 0;
+        for (int b = 0; b < nBins - 1; b++) {
+            leftBounds.extend(axisBounds[b]);
+            leftCount += axisCounts[b];
+            int rightCount = count - leftCount;
+            if (leftCount == 0 || rightCount == 0) continue;
+            double cost = settings.traversalCost + settings.intersectionCost *
+                    (leftCount*leftBounds.area() + rightCount*rightBounds[b + 1].area()) / nodeArea;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = dim;
+                bestBin = b;
+            }
+        }
+    }
+
+    if (bestAxis < 0) return beginning;
+    double leafCost = settings.intersectionCost * count;
+    if (bestCost >= leafCost && count <= settings.maxLeafSize) return beginning;
+
+    n->axis = bestAxis;
+    double mini = centroidBounds.mini[bestAxis];
+    auto pivot = std::partition(order.begin() + beginning, order.begin() + end, [&](int p) {
+        return std::min(nBins - 1, (int) ((centroids[p][bestAxis] - mini) * scale[bestAxis])) <= bestBin;
+    });
+    return pivot - order.begin();
+}
+
+/**
+ * Append the subtree of n to nodes in depth-first order.
+ *
+ * @param n root of the subtree
+ * @return index of n in nodes
+ */
+int BVHBuilder::flatten(const Node* n, std::vector<LinearNode>& nodes, int depth, BVHStatistics& statistics) {
+    int index = nodes.size();
+    nodes.push_back(LinearNode());
+    nodes[index].setBounds(n->b);
+    nodes[index].axis = n->axis;
+    nodes[index].pad = 0;
+    statistics.numberOfNodes++;
+    statistics.maxDepth = std::max(statistics.maxDepth, depth);
+    // the traversal stacks hold BVHStackSize entries, buildNode keeps the depth below it
+    assert(depth < BVHStackSize);
+    if (n->fg) {
+        flatten(n->fg, nodes, depth + 1, statistics);
+        int second = flatten(n->fd, nodes, depth + 1, statistics);
+        nodes[index].offset = second;
+        nodes[index].count = 0;
+    } else {
+        nodes[index].offset = n->beginning;
+        nodes[index].count = n->end - n->beginning;
+        statistics.numberOfLeaves++;
+    }
+    return index;
+}
+
+static double nodeArea(const LinearNode& n) {
+    double dx = n.maxi[0] - n.mini[0], dy = n.maxi[1] - n.mini[1], dz = n.maxi[2] - n.mini[2];
+    return 2*(dx*dy + dy*dz + dz*dx);
+}
+
+/**
+ * Expected cost of tracing a random ray through the BVH under the surface area heuristic.
+ *
+ * Every node is weighted by the probability that a ray hitting the root also hits the node, i.e. the
+ * ratio of their surface areas.
+ */
+double BVHBuilder::computeSAHCost(const std::vector<LinearNode>& nodes, double traversalCost, double intersectionCost) {
+    if (nodes.empty()) return 0;
+    double rootArea = nodeArea(nodes[0]);
+    if (rootArea <= 0) return intersectionCost * nodes[0].count;
+    double cost = 0;
+    for (int i = 0; i < nodes.size(); i++) {
+        double p = nodeArea(nodes[i]) / rootArea;
+        if (nodes[i].isLeaf()) {
+            cost += p * intersectionCost * nodes[i].count;
+        } else {
+            cost += p * traversalCost;
+        }
+    }
+    return cost;
+}
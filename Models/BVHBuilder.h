@@ -0,0 +1,100 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_BVHBUILDER_H
+#define HELLOWORLD_BVHBUILDER_H
+
+#include <atomic>
+#include <vector>
+#include "Vector.h"
+#include "BoundingBox.h"
+#include "Node.h"
+#include "LinearNode.h"
+
+enum BVHSplitMethod {
+    // split at the spatial middle of the longest axis
+    MiddleSplit,
+    // binned surface area heuristic
+    SAHSplit
+};
+
+// widest BVH the node test is vectorised for on this build
+#ifdef __AVX__
+static const int DefaultBVHWidth = 8;
+#else
+static const int DefaultBVHWidth = 4;
+#endif
+
+class BVHSettings {
+public:
+    BVHSettings();
+
+    BVHSplitMethod splitMethod;
+    // number of children per node used for traversal: 2, 4 or 8
+    int width;
+    // SAH cost of visiting an inner node, relative to intersectionCost
+    double traversalCost;
+    // SAH cost of intersecting one primitive
+    double intersectionCost;
+    // number of bins per axis for the SAH split
+    int numberOfBins;
+    // ranges with fewer primitives always become leaves
+    int minLeafSize;
+    // ranges with more primitives are always split
+    int maxLeafSize;
+    // number of build threads, 0 means one per hardware thread
+    int numberOfThreads;
+    // subtrees with at least this many primitives are built on their own thread
+    int parallelSubtreeSize;
+    // nodes with at least this many primitives are binned by all threads together
+    int parallelBinningSize;
+};
+
+class BVHStatistics {
+public:
+    BVHStatistics();
+
+    int numberOfNodes;
+    int numberOfLeaves;
+    int maxDepth;
+    // expected cost of a random ray under the surface area heuristic
+    double sahCost;
+    // build time in seconds
+    double buildTime;
+    // build throughput
+    double primitivesPerSecond;
+};
+
+/**
+ * Builds a BVH over primitives which are only described by their bounding box and centroid.
+ *
+ * The builder does not move the primitives itself. It returns the order in which they have to be stored
+ * so that every leaf references a contiguous range.
+ */
+class BVHBuilder {
+public:
+    BVHBuilder(const BVHSettings& settings, const std::vector<BoundingBox>& bounds, const std::vector<Vector>& centroids);
+    void build(std::vector<LinearNode>& nodes, std::vector<int>& order, BVHStatistics& statistics);
+    static double computeSAHCost(const std::vector<LinearNode>& nodes, double traversalCost, double intersectionCost);
+
+private:
+    void buildNode(Node* n, int beginning, int end, int depth);
+    void computeBounds(Node* n, int beginning, int end, BoundingBox& centroidBounds);
+    int splitMiddle(Node* n, int beginning, int end);
+    int splitMedian(int beginning, int end, int dim);
+    int splitSAH(Node* n, int beginning, int end, const BoundingBox& centroidBounds);
+    int reserveThreads(int wanted);
+    int flatten(const Node* n, std::vector<LinearNode>& nodes, int depth, BVHStatistics& statistics);
+
+    const BVHSettings& settings;
+    const std::vector<BoundingBox>& bounds;
+    const std::vector<Vector>& centroids;
+    std::vector<int> order;
+    int numberOfThreads;
+    // threads currently building a subtree or running a parallel loop, besides the calling thread
+    std::atomic<int> activeThreads;
+};
+
+
+#endif //HELLOWORLD_BVHBUILDER_H
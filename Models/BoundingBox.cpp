@@ -3,26 +3,89 @@
 //
 
 #include "BoundingBox.h"
-bool BoundingBox::intersect(const Ray& r) {
-    double t1x = (mini[0] - r.C[0])/r.u[0];
-    double t2x = (maxi[0] - r.C[0])/r.u[0];
-    double txMin = std::min(t1x, t2x);
-    double txMax = std::max(t1x, t2x);
-
-    double t1y = (mini[1] - r.C[1])/r.u[1];
-    double t2y = (maxi[1] - r.C[1])/r.u[1];
-    double tyMin = std::min(t1y, t2y);
-    double tyMax = std::max(t1y, t2y);
-
-    double t1z = (mini[2] - r.C[2])/r.u[2];
-    double t2z = (maxi[2] - r.C[2])/r.u[2];
-    double tzMin = std::min(t1z, t2z);
-    double tzMax = std::max(t1z, t2z);
-
-    double tMax = std::min(txMax, std::min(tyMax, tzMax));
+
+/**
+ * Create an empty box, extending it by any point or box gives that point or box.
+ */
+template<typename T>
+BoundingBoxT<T>::BoundingBoxT() : mini(1E30, 1E30, 1E30), maxi(-1E30, -1E30, -1E30) {};
+
+template<typename T>
+BoundingBoxT<T>::BoundingBoxT(const VectorT<T>& mini, const VectorT<T>& maxi) : mini(mini), maxi(maxi) {};
+
+template<typename T>
+bool BoundingBoxT<T>::intersect(const RayT<T>& r) {
+    T t1x = (mini[0] - r.C[0])/r.u[0];
+    T t2x = (maxi[0] - r.C[0])/r.u[0];
+    T txMin = std::min(t1x, t2x);
+    T txMax = std::max(t1x, t2x);
+
+    T t1y = (mini[1] - r.C[1])/r.u[1];
+    T t2y = (maxi[1] - r.C[1])/r.u[1];
+    T tyMin = std::min(t1y, t2y);
+    T tyMax = std::max(t1y, t2y);
+
+    T t1z = (mini[2] - r.C[2])/r.u[2];
+    T t2z = (maxi[2] - r.C[2])/r.u[2];
+    T tzMin = std::min(t1z, t2z);
+    T tzMax = std::max(t1z, t2z);
+
+    T tMax = std::min(txMax, std::min(tyMax, tzMax));
     // intersection
-    double tMin = std::max(txMin, std::max(tyMin, tzMin));
+    T tMin = std::max(txMin, std::max(tyMin, tzMin));
 
     if (tMax < 0) return false;
     return tMax > tMin;
 }
+
+
+template<typename T>
+void BoundingBoxT<T>::extend(const VectorT<T>& p) {
+    for (int j = 0; j < 3; j++) {
+        mini[j] = std::min(mini[j], p[j]);
+        maxi[j] = std::max(maxi[j], p[j]);
+    }
+}
+
+template<typename T>
+void BoundingBoxT<T>::extend(const BoundingBoxT<T>& b) {
+    for (int j = 0; j < 3; j++) {
+        mini[j] = std::min(mini[j], b.mini[j]);
+        maxi[j] = std::max(maxi[j], b.maxi[j]);
+    }
+}
+
+template<typename T>
+bool BoundingBoxT<T>::isEmpty() const {
+    return mini[0] > maxi[0] || mini[1] > maxi[1] || mini[2] > maxi[2];
+}
+
+/**
+ * @return surface area of the box, 0 for an empty box
+ */
+template<typename T>
+T BoundingBoxT<T>::area() const {
+    if (isEmpty()) return 0;
+    VectorT<T> diag = maxi - mini;
+    return 2*(diag[0]*diag[1] + diag[1]*diag[2] + diag[2]*diag[0]);
+}
+
+template<typename T>
+VectorT<T> BoundingBoxT<T>::center() const {
+    return 0.5*(mini + maxi);
+}
+
+template<typename T>
+int BoundingBoxT<T>::longestAxis() const {
+    VectorT<T> diag = maxi - mini;
+    if (diag[0] >= diag[1] && diag[0] >= diag[2]) {
+        return 0;
+    }
+    if (diag[1] >= diag[0] && diag[1] >= diag[2]) {
+        return 1;
+    }
+    return 2;
+}
+
+template class BoundingBoxT<float>;
+template class BoundingBoxT<double>;
@@ -9,11 +9,22 @@
 #include "Vector.h"
 #include "Ray.h"
 
-class BoundingBox {
+template<typename T>
+class BoundingBoxT {
 public:
-    bool intersect(const Ray& r);
-    Vector mini, maxi;
+    BoundingBoxT();
+    BoundingBoxT(const VectorT<T>& mini, const VectorT<T>& maxi);
+    bool intersect(const RayT<T>& r);
+    void extend(const VectorT<T>& p);
+    void extend(const BoundingBoxT& b);
+    bool isEmpty() const;
+    T area() const;
+    VectorT<T> center() const;
+    int longestAxis() const;
+    VectorT<T> mini, maxi;
 };
 
+typedef BoundingBoxT<Scalar> BoundingBox;
+
 
 #endif //HELLOWORLD_BOUNDINGBOX_H
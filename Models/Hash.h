@@ -0,0 +1,61 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_HASH_H
+#define HELLOWORLD_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+static const uint64_t HashSeed = 14695981039346656037ULL;
+static const uint64_t HashPrime1 = 11400714785074694791ULL;
+static const uint64_t HashPrime2 = 14029467366897019727ULL;
+
+/**
+ * Finalizer of MurmurHash3, every bit of the result depends on every bit of x.
+ */
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/**
+ * 64-bit hash of a byte range, continuing from hash.
+ *
+ * The range is consumed eight bytes at a time. Every word is mixed on its own before it is combined, so a
+ * change anywhere in a word reaches all bits of the hash, and the result is mixed once more with the size.
+ */
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = HashSeed) {
+    const char* p = static_cast<const char*>(data);
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, p + 8*i, 8);
+        hash ^= mix64(word * HashPrime2);
+        hash = ((hash << 27) | (hash >> 37)) * HashPrime1 + HashPrime2;
+    }
+    // the remaining bytes form a last, zero padded word
+    if (size > 8*words) {
+        uint64_t word = 0;
+        memcpy(&word, p + 8*words, size - 8*words);
+        hash ^= mix64(word * HashPrime2);
+        hash = ((hash << 27) | (hash >> 37)) * HashPrime1 + HashPrime2;
+    }
+    return mix64(hash ^ size);
+}
+
+/**
+ * Mix a value into a hash, e.g. a setting that a cached result depends on.
+ */
+template<typename T>
+inline uint64_t hashValue(uint64_t hash, const T& value) {
+    return hashBytes(&value, sizeof(value), hash);
+}
+
+#endif //HELLOWORLD_HASH_H
@@ -0,0 +1,24 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_HIT_H
+#define HELLOWORLD_HIT_H
+
+#include "Vector.h"
+
+/**
+ * Closest hit of a ray as returned by Scene::intersect, the input of Scene::shade.
+ */
+class Hit {
+public:
+    // hit point, normal at the hit point and error bound of the hit point
+    Vector P, N, pError;
+    Vector albedo;
+    bool mirror, transparent;
+    // index of the hit object in Scene::objects, 0 is the light
+    int objectid;
+};
+
+
+#endif //HELLOWORLD_HIT_H
@@ -0,0 +1,46 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "Instance.h"
+
+Instance::Instance(TriangleMesh* mesh, const Transform& objectToWorld, const Vector& albedo, bool isMirror, bool isTransparent)
+        : mesh(mesh), objectToWorld(objectToWorld), worldToObject(objectToWorld.inverse()) {
+    this->albedo = albedo;
+    this->isMirror = isMirror;
+    this->isTransparent = isTransparent;
+    type = InstanceObject;
+};
+
+/**
+ * Check if a given ray intersects the instance.
+ *
+ * The ray is moved into object space without normalizing its direction, so the distance t is the
+ * same in both spaces.
+ *
+ * @param r incoming ray in world space
+ * @param P intersection point in world space
+ * @param N normal vector in world space
+ * @param pError bound on the absolute error of P in world space
+ * @param t distance of the intersection
+ * @return true if the ray intersects the mesh
+ */
+bool Instance::intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, double &t) {
+    Ray objectRay(worldToObject.applyToPoint(r.C), worldToObject.applyToVector(r.u));
+    Vector objectP, objectN, objectError;
+    if (!mesh->intersect(objectRay, objectP, objectN, objectError, t)) return false;
+
+    P = objectToWorld.applyToPoint(objectP, objectError, pError);
+    // normals are transformed by the transposed inverse
+    N = worldToObject.applyTransposeToVector(objectN).getNormalizedFast();
+    return true;
+}
+
+bool Instance::occluded(const Ray& r, double tMax) {
+    Ray objectRay(worldToObject.applyToPoint(r.C), worldToObject.applyToVector(r.u));
+    return mesh->occluded(objectRay, tMax);
+}
+
+BoundingBox Instance::bounds() {
+    return objectToWorld.applyToBox(mesh->bounds());
+}
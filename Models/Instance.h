@@ -0,0 +1,32 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_INSTANCE_H
+#define HELLOWORLD_INSTANCE_H
+
+#include "Object.h"
+#include "Transform.h"
+#include "TriangleMesh.h"
+
+/**
+ * Placement of a shared mesh in the scene.
+ *
+ * The mesh keeps its vertices and BVH in object space, rays are transformed into object space instead,
+ * so any number of instances share the memory of one mesh.
+ */
+class Instance : public Object {
+public:
+    Instance(TriangleMesh* mesh, const Transform& objectToWorld, const Vector& albedo, bool isMirror=false, bool isTransparent=false);
+    bool intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, double &t);
+    bool occluded(const Ray& r, double tMax);
+    BoundingBox bounds();
+
+    // shared mesh, its BVH has to be built before rendering
+    TriangleMesh* mesh;
+    Transform objectToWorld;
+    Transform worldToObject;
+};
+
+
+#endif //HELLOWORLD_INSTANCE_H
@@ -0,0 +1,20 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <cmath>
+#include <limits>
+#include "BoundingBox.h"
+#include "LinearNode.h"
+
+/**
+ * Store a double precision bounding box, rounding outwards so that the float box still contains it.
+ */
+void LinearNode::setBounds(const BoundingBox& b) {
+    for (int j = 0; j < 3; j++) {
+        mini[j] = (float) b.mini[j];
+        if (mini[j] > b.mini[j]) mini[j] = std::nextafter(mini[j], -std::numeric_limits<float>::infinity());
+        maxi[j] = (float) b.maxi[j];
+        if (maxi[j] < b.maxi[j]) maxi[j] = std::nextafter(maxi[j], std::numeric_limits<float>::infinity());
+    }
+}
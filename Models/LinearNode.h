@@ -0,0 +1,107 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_LINEARNODE_H
+#define HELLOWORLD_LINEARNODE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "BoundingBox.h"
+
+// maximum depth of a BVH, the traversal stack is sized from it
+static const int MaxBVHDepth = 64;
+// extra levels allowed below MaxBVHDepth when a range is still too large for a leaf
+static const int BVHStackSize = MaxBVHDepth + 32;
+
+/**
+ * Node of a BVH flattened into a contiguous array in depth-first order.
+ *
+ * The first child of an inner node is stored right after the node itself, so only the offset of the
+ * second child is needed. The bounds are stored in single precision (rounded outwards), which keeps a
+ * node at 32 bytes, i.e. two nodes per cache line.
+ */
+class LinearNode {
+public:
+    void setBounds(const BoundingBox& b);
+    bool intersect(const Ray& r, const Vector& invU, double tMax, double& tEntry) const;
+    bool isLeaf() const { return count > 0; }
+
+    float mini[3], maxi[3];
+    // leaf: index of the first primitive, inner node: index of the second child
+    int32_t offset;
+    // number of primitives in a leaf, 0 for inner nodes
+    uint16_t count;
+    // axis along which an inner node is split
+    uint8_t axis;
+    uint8_t pad;
+};
+
+static_assert(sizeof(LinearNode) == 32, "LinearNode must stay 32 bytes");
+
+/**
+ * Slab test of the node against a ray segment, kept inline as it runs for every visited node.
+ *
+ * @param r incoming ray
+ * @param invU component-wise inverse of the ray direction
+ * @param tMax end of the segment, usually the closest intersection found so far
+ * @param tEntry distance at which the ray enters the node
+ * @return true if the ray enters the node before tMax
+ */
+inline bool LinearNode::intersect(const Ray& r, const Vector& invU, double tMax, double& tEntry) const {
+    double tMin = 0;
+    for (int j = 0; j < 3; j++) {
+        double t1 = (mini[j] - r.C[j])*invU[j];
+        double t2 = (maxi[j] - r.C[j])*invU[j];
+        if (t1 > t2) std::swap(t1, t2);
+        tMin = t1 > tMin ? t1 : tMin;
+        tMax = t2 < tMax ? t2 : tMax;
+    }
+    tEntry = tMin;
+    return tMin <= tMax;
+}
+
+/**
+ * Visit the leaves of a flattened binary BVH hit by a ray, front to back.
+ *
+ * The tree is traversed with a fixed-size stack: the child on the side the ray comes from is visited
+ * first and nodes which the ray enters beyond tMax are skipped.
+ *
+ * @param nodes flattened BVH, nodes[0] is the root
+ * @param r incoming ray
+ * @param tMax end of the ray segment, may be shortened by leaf
+ * @param leaf called as leaf(first, count) for every leaf reached, returns true to stop the traversal
+ */
+template<typename Leaf>
+inline void traverseBVH(const std::vector<LinearNode>& nodes, const Ray& r, double& tMax, Leaf leaf) {
+    if (nodes.empty()) return;
+    Vector invU(1./r.u[0], 1./r.u[1], 1./r.u[2]);
+    bool dirIsNeg[3] = {invU[0] < 0, invU[1] < 0, invU[2] < 0};
+
+    int stack[BVHStackSize];
+    int stackSize = 0;
+    int current = 0;
+    while (true) {
+        const LinearNode& c = nodes[current];
+        double tEntry;
+        if (c.intersect(r, invU, tMax, tEntry)) {
+            if (!c.isLeaf()) {
+                // visit the near child first, the far child waits on the stack
+                if (dirIsNeg[c.axis]) {
+                    stack[stackSize++] = current + 1;
+                    current = c.offset;
+                } else {
+                    stack[stackSize++] = c.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+            if (leaf(c.offset, c.count)) return;
+        }
+        if (stackSize == 0) return;
+        current = stack[--stackSize];
+    }
+}
+
+#endif //HELLOWORLD_LINEARNODE_H
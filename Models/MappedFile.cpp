@@ -0,0 +1,76 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "MappedFile.h"
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HELLOWORLD_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : begin(nullptr), length(0), mapped(false) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+/**
+ * Map the file at path, a file opened before is closed first.
+ *
+ * @param path path of the file
+ * @return false if the file could not be opened or read
+ */
+bool MappedFile::open(const char* path) {
+    close();
+#ifdef HELLOWORLD_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        ::close(fd);
+        return false;
+    }
+    length = status.st_size;
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            // the file is read front to back once, let the kernel read ahead aggressively
+            madvise(p, length, MADV_SEQUENTIAL);
+            begin = static_cast<const char*>(p);
+            mapped = true;
+        }
+    }
+    ::close(fd);
+    if (mapped || length == 0) return true;
+#endif
+    // no mmap: read the whole file
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buffer.resize(fileSize > 0 ? fileSize : 0);
+    length = fread(buffer.data(), 1, buffer.size(), f);
+    fclose(f);
+    begin = buffer.data();
+    return length == buffer.size();
+}
+
+/**
+ * Unmap the file, data is invalid afterwards.
+ */
+void MappedFile::close() {
+#ifdef HELLOWORLD_MMAP
+    if (mapped) munmap(const_cast<char*>(begin), length);
+#endif
+    begin = nullptr;
+    length = 0;
+    mapped = false;
+    buffer.clear();
+}
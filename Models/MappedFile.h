@@ -0,0 +1,37 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_MAPPEDFILE_H
+#define HELLOWORLD_MAPPEDFILE_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Read-only view of a whole file.
+ *
+ * The file is memory-mapped where mmap is available, so parsing it reads straight from the page cache
+ * without copying it through a buffer. Elsewhere the file is read into memory at once.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    bool open(const char* path);
+    void close();
+    const char* data() const { return begin; }
+    size_t size() const { return length; }
+
+private:
+    const char* begin;
+    size_t length;
+    // true if begin points to a mapping, false if it points into buffer
+    bool mapped;
+    std::vector<char> buffer;
+};
+
+
+#endif //HELLOWORLD_MAPPEDFILE_H
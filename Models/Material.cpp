@@ -0,0 +1,13 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "Material.h"
+
+Material::Material(const Vector& albedo, bool isMirror, bool isTransparent)
+        : albedo(albedo), isMirror(isMirror), isTransparent(isTransparent) {};
+
+bool Material::operator==(const Material& m) const {
+    return albedo[0] == m.albedo[0] && albedo[1] == m.albedo[1] && albedo[2] == m.albedo[2]
+           && isMirror == m.isMirror && isTransparent == m.isTransparent;
+}
@@ -0,0 +1,27 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_MATERIAL_H
+#define HELLOWORLD_MATERIAL_H
+
+#include "Vector.h"
+
+/**
+ * Surface description shared by all objects which look the same, referenced by a compact material id.
+ */
+class Material {
+public:
+    Material(const Vector& albedo, bool isMirror, bool isTransparent);
+    bool operator==(const Material& m) const;
+
+    // color of the surface
+    Vector albedo;
+    // a mirror reflects all incoming rays
+    bool isMirror;
+    // a transparent surface uses Snell's law for incoming rays
+    bool isTransparent;
+};
+
+
+#endif //HELLOWORLD_MATERIAL_H
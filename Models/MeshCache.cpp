@@ -0,0 +1,341 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "MeshCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "TriangleMesh.h"
+
+static const char MeshCacheMagic[8] = {'H', 'W', 'M', 'E', 'S', 'H', 0, 0};
+// the source is hashed in blocks of this size, in parallel, the key does not depend on the number of threads
+static const size_t MeshHashBlockSize = 1 << 24;
+
+static uint64_t alignTo64(uint64_t offset) {
+    return (offset + 63) & ~(uint64_t) 63;
+}
+
+static void fillTypeSizes(uint32_t* sizes) {
+    sizes[0] = sizeof(Scalar);
+    sizes[1] = sizeof(Vector);
+    sizes[2] = sizeof(int32_t);
+    sizes[3] = sizeof(LinearNode);
+    sizes[4] = sizeof(WideNode<4>);
+    sizes[5] = sizeof(WideNode<8>);
+    sizes[6] = sizeof(TriangleBlock);
+}
+
+template<typename T>
+static void placeArray(MeshCacheHeader& header, MeshCacheArray array, const std::vector<T>& v, uint64_t& offset) {
+    header.offsets[array] = offset;
+    header.counts[array] = v.size();
+    offset = alignTo64(offset + v.size() * sizeof(T));
+}
+
+template<typename T>
+static bool writeArray(FILE* f, const MeshCacheHeader& header, MeshCacheArray array, const std::vector<T>& v, uint64_t& position) {
+    static const char zeros[64] = {0};
+    size_t padding = header.offsets[array] - position;
+    if (padding > 0 && fwrite(zeros, 1, padding, f) != padding) return false;
+    if (!v.empty() && fwrite(v.data(), sizeof(T), v.size(), f) != v.size()) return false;
+    position = header.offsets[array] + v.size() * sizeof(T);
+    return true;
+}
+
+template<typename T>
+static bool arrayFits(const MeshCacheHeader& header, MeshCacheArray array, size_t fileSize) {
+    uint64_t offset = header.offsets[array], count = header.counts[array];
+    return offset % 64 == 0 && offset <= fileSize && count <= (fileSize - offset) / sizeof(T);
+}
+
+template<typename T>
+static const T* arrayData(const MappedFile& file, const MeshCacheHeader& header, MeshCacheArray array) {
+    return reinterpret_cast<const T*>(file.data() + header.offsets[array]);
+}
+
+template<typename T>
+static void readArray(const MappedFile& file, const MeshCacheHeader& header, MeshCacheArray array, std::vector<T>& v) {
+    const T* p = arrayData<T>(file, header, array);
+    v.assign(p, p + header.counts[array]);
+}
+
+// an index stream is stored with the width it has in memory
+static void placeStream(MeshCacheHeader& header, MeshCacheArray array, const TriangleIndexStream& stream, uint64_t& offset) {
+    if (stream.isNarrow) {
+        header.narrowIndices |= 1u << (array - CachedPositionIndices);
+        placeArray(header, array, stream.narrow, offset);
+    } else {
+        placeArray(header, array, stream.wide, offset);
+    }
+}
+
+static bool writeStream(FILE* f, const MeshCacheHeader& header, MeshCacheArray array, const TriangleIndexStream& stream, uint64_t& position) {
+    return stream.isNarrow ? writeArray(f, header, array, stream.narrow, position) : writeArray(f, header, array, stream.wide, position);
+}
+
+static bool isNarrowStream(const MeshCacheHeader& header, MeshCacheArray array) {
+    return (header.narrowIndices >> (array - CachedPositionIndices)) & 1;
+}
+
+static bool streamFits(const MeshCacheHeader& header, MeshCacheArray array, size_t fileSize) {
+    return header.counts[array] % 3 == 0 && (isNarrowStream(header, array)
+            ? arrayFits<uint16_t>(header, array, fileSize) : arrayFits<int32_t>(header, array, fileSize));
+}
+
+static void readStream(const MappedFile& file, const MeshCacheHeader& header, MeshCacheArray array, TriangleIndexStream& stream) {
+    stream.clear();
+    stream.isNarrow = isNarrowStream(header, array);
+    if (stream.isNarrow) {
+        readArray(file, header, array, stream.narrow);
+    } else {
+        readArray(file, header, array, stream.wide);
+    }
+}
+
+/**
+ * Check that every index of a stream points into its attribute array.
+ *
+ * @param attributes size of the attribute array
+ * @param optional true if a missing index (-1) is allowed
+ */
+static bool streamValid(const MappedFile& file, const MeshCacheHeader& header, MeshCacheArray array, uint64_t attributes, bool optional) {
+    uint64_t count = header.counts[array];
+    if (isNarrowStream(header, array)) {
+        const uint16_t* p = arrayData<uint16_t>(file, header, array);
+        for (uint64_t i = 0; i < count; i++) {
+            if (p[i] > MaxNarrowIndex ? !optional : p[i] >= attributes) return false;
+        }
+    } else {
+        const int32_t* p = arrayData<int32_t>(file, header, array);
+        for (uint64_t i = 0; i < count; i++) {
+            if (p[i] < 0 ? !optional || p[i] != -1 : (uint64_t) p[i] >= attributes) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check that the binary BVH only references nodes after the current one and blocks which exist, and that
+ * it is not deeper than the traversal stacks.
+ */
+static bool nodesValid(const LinearNode* nodes, uint64_t count, uint64_t blocks) {
+    std::vector<int> depth(count, 0);
+    for (uint64_t n = 0; n < count; n++) {
+        const LinearNode& node = nodes[n];
+        if (depth[n] >= BVHStackSize) return false;
+        if (node.isLeaf()) {
+            if (node.offset < 0 || node.offset + (uint64_t) node.count > blocks) return false;
+            continue;
+        }
+        // the first child follows the node, the second one follows the subtree of the first
+        if (n + 1 >= count || node.offset <= (int64_t) n + 1 || (uint64_t) node.offset >= count) return false;
+        depth[n + 1] = std::max(depth[n + 1], depth[n] + 1);
+        depth[node.offset] = std::max(depth[node.offset], depth[n] + 1);
+    }
+    return true;
+}
+
+/**
+ * Same checks as nodesValid for a collapsed BVH, whose inner children are also stored after their parent.
+ */
+template<int N>
+static bool wideNodesValid(const WideNode<N>* nodes, uint64_t count, uint64_t blocks) {
+    std::vector<int> depth(count, 0);
+    for (uint64_t n = 0; n < count; n++) {
+        const WideNode<N>& node = nodes[n];
+        if (depth[n] >= BVHStackSize) return false;
+        for (int i = 0; i < N; i++) {
+            if (node.count[i] < 0) continue;
+            int32_t child = node.child[i];
+            if (node.count[i] > 0) {
+                if (child < 0 || child + (uint64_t) node.count[i] > blocks) return false;
+                continue;
+            }
+            if (child <= (int64_t) n || (uint64_t) child >= count) return false;
+            depth[child] = std::max(depth[child], depth[n] + 1);
+        }
+    }
+    return true;
+}
+
+/**
+ * Check every index stored in the cache against the size of the array it points into, so that a damaged
+ * file is rejected instead of being read out of bounds during rendering.
+ */
+static bool contentValid(const MappedFile& file, const MeshCacheHeader& header) {
+    uint64_t triangles = header.counts[CachedPositionIndices] / 3;
+    uint64_t blocks = header.counts[CachedBlocks];
+    if ((header.counts[CachedUVIndices] != 0 && header.counts[CachedUVIndices] / 3 != triangles)
+            || (header.counts[CachedNormalIndices] != 0 && header.counts[CachedNormalIndices] / 3 != triangles)
+            || (header.counts[CachedGroups] != 0 && header.counts[CachedGroups] != triangles)) {
+        return false;
+    }
+    if (!streamValid(file, header, CachedPositionIndices, header.counts[CachedVertices], false)
+            || !streamValid(file, header, CachedUVIndices, header.counts[CachedUVs], true)
+            || !streamValid(file, header, CachedNormalIndices, header.counts[CachedNormals], true)) {
+        return false;
+    }
+    if (!nodesValid(arrayData<LinearNode>(file, header, CachedNodes), header.counts[CachedNodes], blocks)
+            || !wideNodesValid<4>(arrayData<WideNode<4> >(file, header, CachedNodes4), header.counts[CachedNodes4], blocks)
+            || !wideNodesValid<8>(arrayData<WideNode<8> >(file, header, CachedNodes8), header.counts[CachedNodes8], blocks)) {
+        return false;
+    }
+    const TriangleBlock* p = arrayData<TriangleBlock>(file, header, CachedBlocks);
+    for (uint64_t b = 0; b < blocks; b++) {
+        for (int lane = 0; lane < TriangleBlockWidth; lane++) {
+            int32_t triangle = p[b].triangle[lane];
+            if (triangle < -1 || (triangle >= 0 && (uint64_t) triangle >= triangles)) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Key of the cache of a mesh: a hash of the content of its source file, of the settings it is optimized
+ * with and of the settings its BVH is built with.
+ *
+ * @param data, size content of the source file
+ * @param optimizerSettings settings of the load-time optimization
+ * @param settings settings of the BVH, only the ones that change the tree are hashed
+ * @param numberOfThreads threads used for hashing, 0 means one per hardware thread
+ */
+uint64_t MeshCache::key(const char* data, size_t size, const MeshOptimizerSettings& optimizerSettings,
+                        const BVHSettings& settings, int numberOfThreads) {
+    int blocks = (int) ((size + MeshHashBlockSize - 1) / MeshHashBlockSize);
+    std::vector<uint64_t> blockHashes(blocks);
+    parallelFor(0, blocks, resolveThreadCount(numberOfThreads), [&](int beginning, int end, int) {
+        for (int b = beginning; b < end; b++) {
+            size_t first = b * MeshHashBlockSize;
+            blockHashes[b] = hashBytes(data + first, std::min(MeshHashBlockSize, size - first));
+        }
+    }, 1);
+    uint64_t hash = hashBytes(blockHashes.data(), blockHashes.size() * sizeof(uint64_t));
+    hash = hashValue(hash, (uint64_t) size);
+    hash = hashValue(hash, (int32_t) optimizerSettings.weldVertices);
+    hash = hashValue(hash, optimizerSettings.weldTolerance);
+    hash = hashValue(hash, (int32_t) optimizerSettings.removeDegenerates);
+    hash = hashValue(hash, (int32_t) optimizerSettings.reorder);
+    hash = hashValue(hash, (int32_t) settings.splitMethod);
+    hash = hashValue(hash, (int32_t) settings.width);
+    hash = hashValue(hash, settings.traversalCost);
+    hash = hashValue(hash, settings.intersectionCost);
+    hash = hashValue(hash, (int32_t) settings.numberOfBins);
+    hash = hashValue(hash, (int32_t) settings.minLeafSize);
+    hash = hashValue(hash, (int32_t) settings.maxLeafSize);
+    return hash;
+}
+
+/**
+ * Write the mesh and its BVH to a cache file.
+ *
+ * The file is written under a temporary name and renamed at the end, so a reader never sees a partial cache.
+ *
+ * @param mesh mesh whose BVH has been built
+ * @param path path of the cache file
+ * @param key key the cache is valid for
+ * @return false if the file could not be written
+ */
+bool MeshCache::save(const TriangleMesh& mesh, const char* path, uint64_t key) {
+    MeshCacheHeader header = MeshCacheHeader();
+    memcpy(header.magic, MeshCacheMagic, sizeof(header.magic));
+    header.version = MeshCacheVersion;
+    fillTypeSizes(header.typeSizes);
+    header.triangleBlockWidth = TriangleBlockWidth;
+    header.key = key;
+    header.bb = mesh.bb;
+    header.statistics = mesh.bvhStatistics;
+    header.optimizerStatistics = mesh.optimizerStatistics;
+
+    uint64_t offset = alignTo64(sizeof(header));
+    placeArray(header, CachedVertices, mesh.vertices, offset);
+    placeArray(header, CachedNormals, mesh.normals, offset);
+    placeArray(header, CachedUVs, mesh.uvs, offset);
+    placeArray(header, CachedVertexColors, mesh.vertexcolors, offset);
+    placeStream(header, CachedPositionIndices, mesh.positionIndices, offset);
+    placeStream(header, CachedUVIndices, mesh.uvIndices, offset);
+    placeStream(header, CachedNormalIndices, mesh.normalIndices, offset);
+    placeArray(header, CachedGroups, mesh.groups, offset);
+    placeArray(header, CachedNodes, mesh.nodes, offset);
+    placeArray(header, CachedNodes4, mesh.nodes4, offset);
+    placeArray(header, CachedNodes8, mesh.nodes8, offset);
+    placeArray(header, CachedBlocks, mesh.blocks, offset);
+
+    std::string temporary = std::string(path) + ".tmp";
+    FILE* f = fopen(temporary.c_str(), "wb");
+    if (!f) return false;
+    uint64_t position = sizeof(header);
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1
+            && writeArray(f, header, CachedVertices, mesh.vertices, position)
+            && writeArray(f, header, CachedNormals, mesh.normals, position)
+            && writeArray(f, header, CachedUVs, mesh.uvs, position)
+            && writeArray(f, header, CachedVertexColors, mesh.vertexcolors, position)
+            && writeStream(f, header, CachedPositionIndices, mesh.positionIndices, position)
+            && writeStream(f, header, CachedUVIndices, mesh.uvIndices, position)
+            && writeStream(f, header, CachedNormalIndices, mesh.normalIndices, position)
+            && writeArray(f, header, CachedGroups, mesh.groups, position)
+            && writeArray(f, header, CachedNodes, mesh.nodes, position)
+            && writeArray(f, header, CachedNodes4, mesh.nodes4, position)
+            && writeArray(f, header, CachedNodes8, mesh.nodes8, position)
+            && writeArray(f, header, CachedBlocks, mesh.blocks, position);
+    written = fclose(f) == 0 && written;
+    if (!written || rename(temporary.c_str(), path) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Replace the mesh and its BVH by the content of a cache file.
+ *
+ * @param mesh mesh to fill, it is left unchanged if the cache cannot be used
+ * @param path path of the cache file
+ * @param key key the cache has to be valid for
+ * @return false if the file does not exist, was written for another key or by an incompatible build, or
+ *         holds an index out of range
+ */
+bool MeshCache::load(TriangleMesh& mesh, const char* path, uint64_t key) {
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(MeshCacheHeader)) return false;
+    MeshCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    uint32_t typeSizes[7];
+    fillTypeSizes(typeSizes);
+    if (memcmp(header.magic, MeshCacheMagic, sizeof(header.magic)) != 0 || header.version != MeshCacheVersion
+            || memcmp(header.typeSizes, typeSizes, sizeof(typeSizes)) != 0
+            || header.triangleBlockWidth != TriangleBlockWidth || header.key != key) {
+        return false;
+    }
+    size_t size = file.size();
+    if (!arrayFits<Vector>(header, CachedVertices, size) || !arrayFits<Vector>(header, CachedNormals, size)
+            || !arrayFits<Vector>(header, CachedUVs, size) || !arrayFits<Vector>(header, CachedVertexColors, size)
+            || !streamFits(header, CachedPositionIndices, size) || !streamFits(header, CachedUVIndices, size)
+            || !streamFits(header, CachedNormalIndices, size) || !arrayFits<int32_t>(header, CachedGroups, size)
+            || !arrayFits<LinearNode>(header, CachedNodes, size)
+            || !arrayFits<WideNode<4> >(header, CachedNodes4, size) || !arrayFits<WideNode<8> >(header, CachedNodes8, size)
+            || !arrayFits<TriangleBlock>(header, CachedBlocks, size) || !contentValid(file, header)) {
+        return false;
+    }
+
+    readArray(file, header, CachedVertices, mesh.vertices);
+    readArray(file, header, CachedNormals, mesh.normals);
+    readArray(file, header, CachedUVs, mesh.uvs);
+    readArray(file, header, CachedVertexColors, mesh.vertexcolors);
+    readStream(file, header, CachedPositionIndices, mesh.positionIndices);
+    readStream(file, header, CachedUVIndices, mesh.uvIndices);
+    readStream(file, header, CachedNormalIndices, mesh.normalIndices);
+    readArray(file, header, CachedGroups, mesh.groups);
+    readArray(file, header, CachedNodes, mesh.nodes);
+    readArray(file, header, CachedNodes4, mesh.nodes4);
+    readArray(file, header, CachedNodes8, mesh.nodes8);
+    readArray(file, header, CachedBlocks, mesh.blocks);
+    mesh.bb = header.bb;
+    mesh.bvhStatistics = header.statistics;
+    mesh.optimizerStatistics = header.optimizerStatistics;
+    return true;
+}
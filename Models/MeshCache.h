@@ -0,0 +1,74 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_MESHCACHE_H
+#define HELLOWORLD_MESHCACHE_H
+
+#include <cstdint>
+#include "BoundingBox.h"
+#include "BVHBuilder.h"
+#include "MeshOptimizer.h"
+
+class TriangleMesh;
+
+// version of the cache layout, files written by another version are rebuilt
+static const uint32_t MeshCacheVersion = 4;
+
+// arrays of a TriangleMesh stored in a cache file, in file order
+enum MeshCacheArray {
+    CachedVertices,
+    CachedNormals,
+    CachedUVs,
+    CachedVertexColors,
+    CachedPositionIndices,
+    CachedUVIndices,
+    CachedNormalIndices,
+    CachedGroups,
+    CachedNodes,
+    CachedNodes4,
+    CachedNodes8,
+    CachedBlocks,
+    NumberOfCachedArrays
+};
+
+/**
+ * Start of a cache file, followed by the arrays at the given offsets, each aligned to 64 bytes.
+ *
+ * The arrays are stored in memory layout, so a cache is only read back by a build with the same Scalar,
+ * SIMD width and byte order. The sizes of all stored types are part of the header to catch any mismatch.
+ */
+class MeshCacheHeader {
+public:
+    char magic[8];
+    uint32_t version;
+    // sizeof of Scalar, Vector, int32_t, LinearNode, WideNode<4>, WideNode<8> and TriangleBlock
+    uint32_t typeSizes[7];
+    uint32_t triangleBlockWidth;
+    // bit n is set if index stream CachedPositionIndices + n is stored with 16-bit indices
+    uint32_t narrowIndices;
+    // hash of the source file and of the BVH settings
+    uint64_t key;
+    uint64_t offsets[NumberOfCachedArrays];
+    uint64_t counts[NumberOfCachedArrays];
+    BoundingBox bb;
+    BVHStatistics statistics;
+    MeshOptimizerStatistics optimizerStatistics;
+};
+
+/**
+ * Binary cache of a loaded mesh together with its BVH.
+ *
+ * Loading a cache maps the file and copies every array with a single memcpy, so neither the OBJ parsing
+ * nor the BVH build are repeated.
+ */
+class MeshCache {
+public:
+    static uint64_t key(const char* data, size_t size, const MeshOptimizerSettings& optimizerSettings,
+                        const BVHSettings& settings, int numberOfThreads);
+    static bool save(const TriangleMesh& mesh, const char* path, uint64_t key);
+    static bool load(TriangleMesh& mesh, const char* path, uint64_t key);
+};
+
+
+#endif //HELLOWORLD_MESHCACHE_H
@@ -0,0 +1,229 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+#include "Morton.h"
+#include "Parallel.h"
+#include "TriangleMesh.h"
+
+// cells of the welding grid per axis are indexed with this many bits
+static const int WeldCellBits = 21;
+
+MeshOptimizerSettings::MeshOptimizerSettings() {
+    weldVertices = true;
+    weldTolerance = 1E-9;
+    removeDegenerates = true;
+    reorder = true;
+}
+
+MeshOptimizerStatistics::MeshOptimizerStatistics() {
+    weldedVertices = 0;
+    degenerateTriangles = 0;
+    unusedVertices = 0;
+    time = 0;
+}
+
+static BoundingBox vertexBounds(const std::vector<Vector>& vertices) {
+    BoundingBox bounds;
+    bounds.mini = Vector(1E9, 1E9, 1E9);
+    bounds.maxi = Vector(-1E9, -1E9, -1E9);
+    for (const Vector& v : vertices) {
+        for (int j = 0; j < 3; j++) {
+            bounds.mini[j] = std::min(bounds.mini[j], v[j]);
+            bounds.maxi[j] = std::max(bounds.maxi[j], v[j]);
+        }
+    }
+    return bounds;
+}
+
+static bool sameVector(const Vector& a, const Vector& b) {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+/**
+ * Run the enabled steps of the pass on a mesh whose BVH has not been built yet.
+ *
+ * @param numberOfThreads threads used for the Morton codes, 0 means one per hardware thread
+ */
+void MeshOptimizer::optimize(TriangleMesh& mesh, const MeshOptimizerSettings& settings, MeshOptimizerStatistics& statistics, int numberOfThreads) {
+    auto start = std::chrono::steady_clock::now();
+    statistics = MeshOptimizerStatistics();
+    if (settings.weldVertices) {
+        statistics.weldedVertices = weldVertices(mesh, settings.weldTolerance);
+    }
+    if (settings.removeDegenerates) {
+        statistics.degenerateTriangles = removeDegenerateTriangles(mesh);
+    }
+    if (settings.reorder) {
+        sortTriangles(mesh, resolveThreadCount(numberOfThreads));
+        statistics.unusedVertices = renumberVertices(mesh);
+    }
+    statistics.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Merge every vertex into an earlier kept vertex which is within the tolerance along every axis.
+ *
+ * The vertices are hashed into a grid of cells much larger than the tolerance, so most vertices only
+ * compare against the earlier vertices of their own cell. The cells are searched in order and each one
+ * from its most recently kept vertex back, the first match wins. Which vertex that is only matters when
+ * several kept vertices lie within the tolerance, and it depends on the order of the vertices alone.
+ * Vertices with different colors are never merged.
+ *
+ * @param tolerance distance relative to the diagonal of the bounds of the vertices
+ * @return number of vertices removed
+ */
+int MeshOptimizer::weldVertices(TriangleMesh& mesh, double tolerance) {
+    int n = mesh.vertices.size();
+    if (n == 0) return 0;
+    bool colored = mesh.vertexcolors.size() == mesh.vertices.size();
+    BoundingBox bounds = vertexBounds(mesh.vertices);
+    double diagonal = sqrt((bounds.maxi - bounds.mini).sqrNorm());
+    double distance = tolerance * diagonal;
+    double cellSize = std::max(16 * distance, diagonal / (1 << (WeldCellBits - 1)));
+    if (cellSize <= 0) cellSize = 1;
+
+    // only the vertices which are kept are inserted, nextInCell chains the ones of the same cell, newest first
+    std::unordered_map<uint64_t, int> firstInCell;
+    firstInCell.reserve(n);
+    std::vector<int> nextInCell(n, -1);
+    std::vector<int> newIndex(n);
+    int kept = 0;
+    for (int v = 0; v < n; v++) {
+        const Vector& p = mesh.vertices[v];
+        int cell[3], lower[3], upper[3];
+        for (int j = 0; j < 3; j++) {
+            double x = (p[j] - bounds.mini[j]) / cellSize;
+            cell[j] = (int) x;
+            lower[j] = std::max(0, x - cell[j] < distance / cellSize ? cell[j] - 1 : cell[j]);
+            upper[j] = cell[j] + 1 - x < distance / cellSize ? cell[j] + 1 : cell[j];
+        }
+        int found = -1;
+        for (int cx = lower[0]; cx <= upper[0] && found < 0; cx++) {
+            for (int cy = lower[1]; cy <= upper[1] && found < 0; cy++) {
+                for (int cz = lower[2]; cz <= upper[2] && found < 0; cz++) {
+                    auto first = firstInCell.find((uint64_t) cx << (2 * WeldCellBits) | (uint64_t) cy << WeldCellBits | cz);
+                    for (int w = first == firstInCell.end() ? -1 : first->second; w >= 0 && found < 0; w = nextInCell[w]) {
+                        Vector d = absolute(mesh.vertices[w] - p);
+                        if (d[0] <= distance && d[1] <= distance && d[2] <= distance
+                                && (!colored || sameVector(mesh.vertexcolors[w], mesh.vertexcolors[v]))) {
+                            found = w;
+                        }
+                    }
+                }
+            }
+        }
+        if (found >= 0) {
+            newIndex[v] = newIndex[found];
+        } else {
+            newIndex[v] = kept++;
+            uint64_t key = (uint64_t) cell[0] << (2 * WeldCellBits) | (uint64_t) cell[1] << WeldCellBits | cell[2];
+            auto first = firstInCell.find(key);
+            if (first != firstInCell.end()) {
+                nextInCell[v] = first->second;
+                first->second = v;
+            } else {
+                firstInCell[key] = v;
+            }
+        }
+    }
+    if (kept < n) remapVertices(mesh, newIndex, kept);
+    return n - kept;
+}
+
+/**
+ * Drop the triangles which use a vertex twice or whose corners are collinear.
+ *
+ * @return number of triangles removed
+ */
+int MeshOptimizer::removeDegenerateTriangles(TriangleMesh& mesh) {
+    std::vector<int> kept;
+    kept.reserve(mesh.triangleCount());
+    for (int t = 0; t < mesh.triangleCount(); t++) {
+        int a, b, c;
+        mesh.positionIndices.get(t, a, b, c);
+        if (a == b || b == c || a == c) continue;
+        const Vector& A = mesh.vertices[a];
+        if (cross(mesh.vertices[b] - A, mesh.vertices[c] - A).sqrNorm() == 0) continue;
+        kept.push_back(t);
+    }
+    int removed = mesh.triangleCount() - kept.size();
+    if (removed > 0) mesh.permuteTriangles(kept);
+    return removed;
+}
+
+/**
+ * Sort the triangles by the Morton code of their centroid within the bounds of the vertices.
+ */
+void MeshOptimizer::sortTriangles(TriangleMesh& mesh, int numberOfThreads) {
+    BoundingBox bounds = vertexBounds(mesh.vertices);
+    Vector extent = bounds.maxi - bounds.mini;
+    Vector scale(extent[0] > 0 ? 1 / extent[0] : 0, extent[1] > 0 ? 1 / extent[1] : 0, extent[2] > 0 ? 1 / extent[2] : 0);
+    // key: 30 bits Morton code, 32 bits triangle index, so equal codes keep the file order
+    std::vector<uint64_t> keys(mesh.triangleCount());
+    parallelFor(0, keys.size(), numberOfThreads, [&](int beginning, int end, int) {
+        for (int t = beginning; t < end; t++) {
+            int a, b, c;
+            mesh.positionIndices.get(t, a, b, c);
+            Vector p = (mesh.vertices[a] + mesh.vertices[b] + mesh.vertices[c]) / 3. - bounds.mini;
+            keys[t] = (uint64_t) mortonCode(p[0] * scale[0], p[1] * scale[1], p[2] * scale[2]) << 32 | (uint32_t) t;
+        }
+    });
+    std::sort(keys.begin(), keys.end());
+    std::vector<int> order(keys.size());
+    for (size_t t = 0; t < keys.size(); t++) {
+        order[t] = (int) (keys[t] & 0xFFFFFFFF);
+    }
+    mesh.permuteTriangles(order);
+}
+
+/**
+ * Number the vertices in the order the triangles first use them and drop the ones no triangle uses.
+ *
+ * @return number of vertices removed
+ */
+int MeshOptimizer::renumberVertices(TriangleMesh& mesh) {
+    std::vector<int> newIndex(mesh.vertices.size(), -1);
+    int next = 0;
+    for (int t = 0; t < mesh.triangleCount(); t++) {
+        int corners[3];
+        mesh.positionIndices.get(t, corners[0], corners[1], corners[2]);
+        for (int c = 0; c < 3; c++) {
+            if (newIndex[corners[c]] < 0) newIndex[corners[c]] = next++;
+        }
+    }
+    int removed = mesh.vertices.size() - next;
+    remapVertices(mesh, newIndex, next);
+    return removed;
+}
+
+/**
+ * Move vertex v, and its color, to newIndex[v] and update the position indices.
+ *
+ * @param newIndex new index of every vertex, -1 drops it, of the vertices moved to the same index the first one is kept
+ * @param numberOfVertices number of vertices afterwards
+ */
+void MeshOptimizer::remapVertices(TriangleMesh& mesh, const std::vector<int>& newIndex, int numberOfVertices) {
+    bool colored = mesh.vertexcolors.size() == mesh.vertices.size();
+    std::vector<Vector> vertices(numberOfVertices), colors(colored ? numberOfVertices : 0);
+    std::vector<bool> placed(numberOfVertices, false);
+    for (size_t v = 0; v < mesh.vertices.size(); v++) {
+        int n = newIndex[v];
+        if (n < 0 || placed[n]) continue;
+        placed[n] = true;
+        vertices[n] = mesh.vertices[v];
+        if (colored) colors[n] = mesh.vertexcolors[v];
+    }
+    mesh.vertices.swap(vertices);
+    if (colored) mesh.vertexcolors.swap(colors);
+    for (int t = 0; t < mesh.triangleCount(); t++) {
+        int a, b, c;
+        mesh.positionIndices.get(t, a, b, c);
+        mesh.positionIndices.set(t, newIndex[a], newIndex[b], newIndex[c]);
+    }
+}
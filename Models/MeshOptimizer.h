@@ -0,0 +1,56 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_MESHOPTIMIZER_H
+#define HELLOWORLD_MESHOPTIMIZER_H
+
+#include <vector>
+
+class TriangleMesh;
+
+class MeshOptimizerSettings {
+public:
+    MeshOptimizerSettings();
+
+    // merge vertices closer than weldTolerance along every axis
+    bool weldVertices;
+    // distance below which vertices are merged, relative to the diagonal of the mesh bounds, 0 merges exact duplicates only
+    double weldTolerance;
+    // drop triangles with zero area
+    bool removeDegenerates;
+    // sort the triangles along a Morton curve and number the vertices in the order they are first used
+    bool reorder;
+};
+
+class MeshOptimizerStatistics {
+public:
+    MeshOptimizerStatistics();
+
+    int weldedVertices;
+    int degenerateTriangles;
+    // vertices no triangle uses, dropped while reordering
+    int unusedVertices;
+    // time of the whole pass in seconds
+    double time;
+};
+
+/**
+ * Load-time pass which cleans a mesh up and makes it cache friendly before its BVH is built.
+ *
+ * Duplicated vertices are welded and the triangles they collapse dropped. The triangles are then sorted by
+ * the Morton code of their centroid and the vertices renumbered in the order the triangles use them, so
+ * the triangles of a BVH leaf and their vertices end up close together in memory.
+ */
+class MeshOptimizer {
+public:
+    static void optimize(TriangleMesh& mesh, const MeshOptimizerSettings& settings, MeshOptimizerStatistics& statistics, int numberOfThreads = 0);
+    static int weldVertices(TriangleMesh& mesh, double tolerance);
+    static int removeDegenerateTriangles(TriangleMesh& mesh);
+    static void sortTriangles(TriangleMesh& mesh, int numberOfThreads);
+    static int renumberVertices(TriangleMesh& mesh);
+    static void remapVertices(TriangleMesh& mesh, const std::vector<int>& newIndex, int numberOfVertices);
+};
+
+
+#endif //HELLOWORLD_MESHOPTIMIZER_H
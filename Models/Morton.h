@@ -0,0 +1,36 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_MORTON_H
+#define HELLOWORLD_MORTON_H
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * Spread the lower 10 bits of x so that two zero bits separate consecutive bits.
+ */
+inline uint32_t expandBits(uint32_t x) {
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+/**
+ * 30 bit Morton code of a point, points close in space get close codes.
+ *
+ * @param x, y, z coordinates relative to the grid, in [0, 1]
+ * @return interleaved bits of the 10 bit grid cell index along every axis
+ */
+inline uint32_t mortonCode(double x, double y, double z) {
+    uint32_t ix = (uint32_t) std::min(std::max(x * 1024, 0.), 1023.);
+    uint32_t iy = (uint32_t) std::min(std::max(y * 1024, 0.), 1023.);
+    uint32_t iz = (uint32_t) std::min(std::max(z * 1024, 0.), 1023.);
+    return (expandBits(ix) << 2) | (expandBits(iy) << 1) | expandBits(iz);
+}
+
+#endif //HELLOWORLD_MORTON_H
@@ -3,3 +3,10 @@
 //
 
 #include "Node.h"
+
+Node::Node() : fg(NULL), fd(NULL), beginning(0), end(0), axis(0) {};
+
+Node::~Node() {
+    delete fg;
+    delete fd;
+}
@@ -7,12 +7,17 @@
 
 #include "BoundingBox.h"
 
+// node of the BVH while it is being built, it is flattened into LinearNodes afterwards
 class Node {
 
 public:
+    Node();
+    ~Node();
     Node *fg, *fd;
     BoundingBox b;
     int beginning, end;
+    // axis along which the node is split
+    int axis;
 };
 
 
@@ -0,0 +1,217 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_OBJPARSING_H
+#define HELLOWORLD_OBJPARSING_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Tokenizer of the OBJ loader. All functions work on the range [p, end) of a line, which does not have
+ * to be null-terminated, and advance p past what they consumed.
+ */
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+/**
+ * @return start of the line after p, or end if p is in the last line
+ */
+inline const char* nextLine(const char* p, const char* end) {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    return eol ? eol + 1 : end;
+}
+
+/**
+ * Parse an integer with an optional sign.
+ *
+ * @return false if p does not point to a number, p is left unchanged then
+ */
+inline bool parseInt(const char*& p, const char* end, int& value) {
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+    if (s == end || *s < '0' || *s > '9') return false;
+    int v = 0;
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = 10*v + (*s++ - '0');
+    }
+    value = negative ? -v : v;
+    p = s;
+    return true;
+}
+
+/**
+ * Parse a decimal floating-point number, leading blanks are skipped.
+ *
+ * Numbers with at most 15 significant digits and a decimal exponent of at most 22 are converted with a
+ * single multiplication or division of two exact doubles, which rounds correctly. All other numbers,
+ * including inf and nan, go through strtod, so the result always equals that of strtod.
+ *
+ * @return false if p does not point to a number, p is left unchanged then
+ */
+inline bool parseDouble(const char*& p, const char* end, double& value) {
+    static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char* start = skipBlanks(p, end);
+    const char* s = start;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+
+    uint64_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+    while (s < end && *s >= '0' && *s <= '9') {
+        if (mantissa || *s != '0') significantDigits++;
+        if (significantDigits <= 19) mantissa = 10*mantissa + (*s - '0'); else exponent++;
+        anyDigit = true;
+        s++;
+    }
+    if (s < end && *s == '.') {
+        s++;
+        while (s < end && *s >= '0' && *s <= '9') {
+            if (mantissa || *s != '0') significantDigits++;
+            if (significantDigits <= 19) {
+                mantissa = 10*mantissa + (*s - '0');
+                exponent--;
+            }
+            anyDigit = true;
+            s++;
+        }
+    }
+    if (anyDigit && s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        int decimalExponent;
+        if (parseInt(e, end, decimalExponent)) {
+            exponent += decimalExponent;
+            s = e;
+        }
+    }
+
+    if (anyDigit && significantDigits <= 15 && exponent >= -22 && exponent <= 22) {
+        double v = (double) mantissa;
+        v = exponent < 0 ? v / powersOfTen[-exponent] : v * powersOfTen[exponent];
+        value = negative ? -v : v;
+        p = s;
+        return true;
+    }
+
+    // slow path, strtod needs a null-terminated copy
+    char token[128];
+    const char* tokenEnd = start;
+    while (tokenEnd < end && !isBlank(*tokenEnd) && *tokenEnd != '\n' && tokenEnd - start < 127) tokenEnd++;
+    size_t tokenLength = tokenEnd - start;
+    memcpy(token, start, tokenLength);
+    token[tokenLength] = '\0';
+    char* parsedEnd;
+    double v = strtod(token, &parsedEnd);
+    if (parsedEnd == token) return false;
+    value = v;
+    p = start + (parsedEnd - token);
+    return true;
+}
+
+/**
+ * Parse one vertex of a face, given as v, v/t, v//n or v/t/n, leading blanks are skipped.
+ *
+ * @param v, t, n indices as written in the file, 0 for the ones that are missing
+ * @return false if p does not point to a vertex
+ */
+inline bool parseFaceVertex(const char*& p, const char* end, int& v, int& t, int& n) {
+    const char* s = skipBlanks(p, end);
+    t = 0;
+    n = 0;
+    if (!parseInt(s, end, v)) return false;
+    if (s < end && *s == '/') {
+        s++;
+        parseInt(s, end, t);
+        if (s < end && *s == '/') {
+            s++;
+            parseInt(s, end, n);
+        }
+    }
+    p = s;
+    return true;
+}
+
+/**
+ * Turn an OBJ index into an array index: positive indices count from 1, negative ones back from the last
+ * element read so far.
+ *
+ * @param count number of elements read so far
+ * @return index into the array, -1 for a missing index
+ */
+inline int resolveObjIndex(int index, size_t count) {
+    return index < 0 ? (int) count + index : index - 1;
+}
+
+// kind of a line of an OBJ file
+enum ObjLineType {
+    ObjVertex,
+    ObjNormal,
+    ObjUV,
+    ObjFace,
+    ObjMaterial,
+    ObjOther
+};
+
+/**
+ * @param p first non-blank character of the line
+ * @param eol end of the line
+ */
+inline ObjLineType objLineType(const char* p, const char* eol) {
+    if (eol - p < 2) return ObjOther;
+    if (p[0] == 'v') {
+        if (isBlank(p[1])) return ObjVertex;
+        if (p[1] == 'n') return ObjNormal;
+        if (p[1] == 't') return ObjUV;
+        return ObjOther;
+    }
+    if (p[0] == 'f' && isBlank(p[1])) return ObjFace;
+    if (eol - p >= 6 && strncmp(p, "usemtl", 6) == 0) return ObjMaterial;
+    return ObjOther;
+}
+
+/**
+ * Number of lines of every kind in a part of an OBJ file.
+ *
+ * Summed over the parts before a part, they give the indices of its first vertex, normal and uv and its
+ * first group, which lets the parts be parsed independently.
+ */
+class ObjCounts {
+public:
+    ObjCounts() : vertices(0), normals(0), uvs(0), faces(0), groups(0) {}
+    size_t vertices, normals, uvs, faces;
+    int groups;
+};
+
+/**
+ * Count the lines of every kind in [begin, end), which has to start at the beginning of a line.
+ */
+inline ObjCounts countObjLines(const char* begin, const char* end) {
+    ObjCounts counts;
+    for (const char* line = begin; line < end; line = nextLine(line, end)) {
+        const char* p = skipBlanks(line, end);
+        switch (objLineType(p, end)) {
+            case ObjVertex: counts.vertices++; break;
+            case ObjNormal: counts.normals++; break;
+            case ObjUV: counts.uvs++; break;
+            case ObjFace: counts.faces++; break;
+            case ObjMaterial: counts.groups++; break;
+            default: break;
+        }
+    }
+    return counts;
+}
+
+#endif //HELLOWORLD_OBJPARSING_H
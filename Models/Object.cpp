@@ -2,5 +2,60 @@
 // Created by Martin Voigt on 10.02.21.
 //
 
+#include <limits>
 #include "Object.h"
 
+/**
+ * Check if the object lies on the ray segment (0, tMax).
+ *
+ * Objects without a faster test fall back to the closest hit.
+ *
+ * @param r incoming ray
+ * @param tMax end of the segment
+ * @return true if the segment is blocked by the object
+ */
+bool Object::occluded(const Ray& r, double tMax) {
+    Vector P, N, pError;
+    double t;
+    return intersect(r, P, N, pError, t) && t < tMax;
+}
+
+/**
+ * World space bounds of the object, used by the top-level BVH of the scene.
+ *
+ * Objects without finite bounds return an infinite box and are tested against every ray.
+ */
+BoundingBox Object::bounds() {
+    double inf = std::numeric_limits<double>::infinity();
+    return BoundingBox(Vector(-inf, -inf, -inf), Vector(inf, inf, inf));
+}
+
+/**
+ * Intersect the rays of a packet with the object, keeping only hits closer than the ones found so far.
+ *
+ * Objects without a packet traversal fall back to one intersect call per ray.
+ *
+ * @param packet rays to intersect
+ * @param mask lanes to test
+ * @param t closest hit of every lane so far, updated on a closer hit
+ * @param P intersection point of every lane
+ * @param normal normal vector at the intersection point of every lane
+ * @param pError bound on the absolute error of P of every lane
+ * @return bit mask of the lanes with a closer hit
+ */
+int Object::intersectPacket(const RayPacket& packet, int mask, double* t, Vector* P, Vector* normal, Vector* pError) {
+    int hits = 0;
+    for (int lane = 0; lane < packet.count; lane++) {
+        if (!(mask & (1 << lane))) continue;
+        Vector localP, localN, localError;
+        double localt;
+        if (intersect(Ray(packet.origins[lane], packet.directions[lane]), localP, localN, localError, localt) && localt < t[lane]) {
+            t[lane] = localt;
+            P[lane] = localP;
+            normal[lane] = localN;
+            pError[lane] = localError;
+            hits |= 1 << lane;
+        }
+    }
+    return hits;
+}
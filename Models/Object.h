@@ -7,18 +7,35 @@
 
 #include "Vector.h"
 #include "Ray.h"
+#include "BoundingBox.h"
+#include "RayPacket.h"
+
+// concrete type of an object, lets the scene dispatch its queries with a switch instead of virtual calls
+enum ObjectType {
+    SphereObject,
+    MeshObject,
+    InstanceObject,
+    PlaneObject,
+    QuadObject,
+    OtherObject
+};
 
 class Object {
 public:
-    Object() {};
-    virtual bool intersect(const Ray& r, Vector& P, Vector& normal, double &t) = 0;
+    Object() : isMirror(false), isTransparent(false), type(OtherObject) {};
+    virtual bool intersect(const Ray& r, Vector& P, Vector& normal, Vector& pError, double &t) = 0;
+    virtual bool occluded(const Ray& r, double tMax);
+    virtual BoundingBox bounds();
+    virtual int intersectPacket(const RayPacket& packet, int mask, double* t, Vector* P, Vector* normal, Vector* pError);
 
-    // color of the sphere
+    // color of the object
     Vector albedo;
-    // a mirror sphere is a sphere which reflects all incoming rays
+    // a mirror object reflects all incoming rays
     bool isMirror;
-    // a transparent sphere uses Snell's law for incoming rays
+    // a transparent object uses Snell's law for incoming rays
     bool isTransparent;
+    // set by the constructor of the subclass
+    ObjectType type;
 };
 
 
@@ -0,0 +1,61 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_PARALLEL_H
+#define HELLOWORLD_PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * @param numberOfThreads requested number of threads, 0 means one per hardware thread
+ * @return number of threads to use, at least 1
+ */
+inline int resolveThreadCount(int numberOfThreads) {
+    if (numberOfThreads > 0) return numberOfThreads;
+    return std::max(1, (int) std::thread::hardware_concurrency());
+}
+
+// ranges are not split into chunks smaller than this by default, so short loops run on the calling thread
+static const int DefaultGrainSize = 1024;
+
+/**
+ * Number of chunks a range is split into.
+ *
+ * @param grainSize minimum number of elements per chunk
+ */
+inline int chunkCount(int count, int numberOfThreads, int grainSize) {
+    int chunks = (int) std::min((long long) numberOfThreads, ((long long) count + grainSize - 1) / std::max(1, grainSize));
+    return std::max(1, chunks);
+}
+
+/**
+ * Split [beginning, end) into one contiguous chunk per thread and call f(chunkBeginning, chunkEnd, chunk)
+ * for every chunk. The calling thread processes the first chunk itself.
+ *
+ * Every call starts its own threads. Loops which run many times, like the stages of the wavefront integrator,
+ * should use a ThreadPool instead.
+ *
+ * @param grainSize minimum number of elements per chunk, use 1 for ranges of large work items
+ * @return number of chunks
+ */
+template<typename F>
+int parallelFor(int beginning, int end, int numberOfThreads, F f, int grainSize = DefaultGrainSize) {
+    int count = end - beginning;
+    int chunks = chunkCount(count, numberOfThreads, grainSize);
+    std::vector<std::thread> threads;
+    for (int c = 1; c < chunks; c++) {
+        int chunkBeginning = beginning + (long long) count * c / chunks;
+        int chunkEnd = beginning + (long long) count * (c + 1) / chunks;
+        threads.push_back(std::thread(f, chunkBeginning, chunkEnd, c));
+    }
+    f(beginning, beginning + count / chunks, 0);
+    for (int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    return chunks;
+}
+
+#endif //HELLOWORLD_PARALLEL_H
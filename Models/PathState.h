@@ -0,0 +1,28 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_PATHSTATE_H
+#define HELLOWORLD_PATHSTATE_H
+
+#include "Vector.h"
+
+/**
+ * State a path carries from one bounce to the next, updated by Scene::shade.
+ */
+class PathState {
+public:
+    PathState() : throughput(1, 1, 1), radiance(0, 0, 0), lastDiffuse(false), rebound(0) {}
+
+    // fraction of the light arriving along the current ray that reaches the camera
+    Vector throughput;
+    // light of the path found so far
+    Vector radiance;
+    // indicates if the current ray was scattered by a diffuse surface
+    bool lastDiffuse;
+    // number of bounces before the current ray
+    int rebound;
+};
+
+
+#endif //HELLOWORLD_PATHSTATE_H
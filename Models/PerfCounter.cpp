@@ -0,0 +1,61 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "PerfCounter.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+PerfCounter::PerfCounter() : fd(-1) {
+#ifdef __linux__
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+PerfCounter::~PerfCounter() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+}
+
+/**
+ * Reset the counter and start counting.
+ */
+void PerfCounter::start() {
+#ifdef __linux__
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+/**
+ * Stop counting.
+ *
+ * @return number of cache misses since start, -1 if the counter is not available
+ */
+long long PerfCounter::stop() {
+#ifdef __linux__
+    if (fd < 0) return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long count;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+    return count;
+#else
+    return -1;
+#endif
+}
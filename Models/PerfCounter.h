@@ -0,0 +1,29 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_PERFCOUNTER_H
+#define HELLOWORLD_PERFCOUNTER_H
+
+/**
+ * Hardware cache miss counter of the thread which creates it. It can be started and stopped from any thread.
+ *
+ * Uses perf_event_open on Linux. Where it is not available (other systems, containers, a restrictive
+ * perf_event_paranoid) the counter stays closed and stop returns -1.
+ */
+class PerfCounter {
+public:
+    PerfCounter();
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+    ~PerfCounter();
+    bool isAvailable() const { return fd >= 0; }
+    void start();
+    long long stop();
+
+private:
+    int fd;
+};
+
+
+#endif //HELLOWORLD_PERFCOUNTER_H
@@ -0,0 +1,44 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "Plane.h"
+
+Plane::Plane(const Vector& Q, const Vector& N, const Vector& albedo, bool isMirror, bool isTransparent) {
+    this->Q = Q;
+    this->N = N.getNormalized();
+    this->albedo = albedo;
+    this->isMirror = isMirror;
+    this->isTransparent = isTransparent;
+    type = PlaneObject;
+}
+
+/**
+ * Check if a given ray intersects the plane.
+ *
+ * @param r incoming ray
+ * @param P intersection point
+ * @param N normal vector of the plane
+ * @param pError bound on the absolute error of P
+ * @param t distance of the intersection
+ * @return true if the ray hits the plane at t > 0
+ */
+bool Plane::intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, double &t) {
+    Scalar localt = dot(Q - r.C, this->N) / dot(r.u, this->N);
+    // also rejects rays parallel to the plane, for which localt is infinite or NaN
+    if (!(localt > 0)) return false;
+    Vector tu = localt * r.u;
+    P = r.C + tu;
+    N = this->N;
+    pError = gammaBound<Scalar>(7) * (absolute(Q) + absolute(r.C) + absolute(tu));
+    t = localt;
+    return true;
+}
+
+/**
+ * Check if the plane crosses the ray segment (0, tMax).
+ */
+bool Plane::occluded(const Ray& r, double tMax) {
+    Scalar localt = dot(Q - r.C, N) / dot(r.u, N);
+    return localt > 0 && localt < tMax;
+}
@@ -0,0 +1,31 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_PLANE_H
+#define HELLOWORLD_PLANE_H
+
+#include "Vector.h"
+#include "Ray.h"
+#include "Object.h"
+
+/**
+ * Infinite plane through Q, lit on the side N points to.
+ *
+ * A plane has no finite bounds, so the scene tests it against every ray next to the top-level BVH. It
+ * suits surfaces such as a floor which most rays end on anyway, bounded walls are better built from quads.
+ */
+class Plane : public Object {
+public:
+    Plane(const Vector& Q, const Vector& N, const Vector& albedo, bool isMirror=false, bool isTransparent=false);
+    bool intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, double &t);
+    bool occluded(const Ray& r, double tMax);
+
+    // point on the plane
+    Vector Q;
+    // normalized normal vector
+    Vector N;
+};
+
+
+#endif //HELLOWORLD_PLANE_H
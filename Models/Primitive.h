@@ -0,0 +1,29 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_PRIMITIVE_H
+#define HELLOWORLD_PRIMITIVE_H
+
+#include "Vector.h"
+#include "Object.h"
+
+/**
+ * Entry of the primitive table of a scene, one per object.
+ *
+ * The type tag selects the intersection routine with a switch. Spheres are stored by value, so testing
+ * them does not touch the object at all.
+ */
+class Primitive {
+public:
+    ObjectType type;
+    // index of the object in Scene::objects
+    int object;
+    // index of the material in Scene::materials
+    int material;
+    // center and radius if type is SphereObject
+    Vector O;
+    Scalar R;
+};
+
+#endif //HELLOWORLD_PRIMITIVE_H
@@ -0,0 +1,82 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "Quad.h"
+
+/**
+ * Create the quad spanned by mini and maxi, flattened along the axis N points to.
+ *
+ * @param mini, maxi opposite corners, their coordinate along the axis of N is taken from mini
+ * @param N side the quad faces, only the sign of its largest component is kept
+ */
+Quad::Quad(const Vector& mini, const Vector& maxi, const Vector& N, const Vector& albedo, bool isMirror, bool isTransparent) {
+    axis = 0;
+    for (int i = 1; i < 3; i++) {
+        if (std::abs(N[i]) > std::abs(N[axis])) axis = i;
+    }
+    for (int i = 0; i < 3; i++) {
+        this->mini[i] = std::min(mini[i], maxi[i]);
+        this->maxi[i] = std::max(mini[i], maxi[i]);
+    }
+    this->mini[axis] = mini[axis];
+    this->maxi[axis] = mini[axis];
+    this->N = Vector(0, 0, 0);
+    this->N[axis] = N[axis] < 0 ? -1 : 1;
+    this->albedo = albedo;
+    this->isMirror = isMirror;
+    this->isTransparent = isTransparent;
+    type = QuadObject;
+}
+
+/**
+ * Check if a given ray intersects the quad.
+ *
+ * The hit point takes the coordinate of the plane along axis, its error lies only within the plane.
+ *
+ * @param r incoming ray
+ * @param P intersection point
+ * @param N normal vector of the quad
+ * @param pError bound on the absolute error of P
+ * @param t distance of the intersection
+ * @return true if the ray hits the quad at t > 0
+ */
+bool Quad::intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, double &t) {
+    // the sign of the difference is exact, so a ray starting on the plane never hits it again
+    Scalar localt = (mini[axis] - r.C[axis]) / r.u[axis];
+    if (!(localt > 0)) return false;
+    int a1 = axis == 2 ? 0 : axis + 1;
+    int a2 = a1 == 2 ? 0 : a1 + 1;
+    Scalar x = r.C[a1] + localt * r.u[a1];
+    if (x < mini[a1] || x > maxi[a1]) return false;
+    Scalar y = r.C[a2] + localt * r.u[a2];
+    if (y < mini[a2] || y > maxi[a2]) return false;
+
+    P[axis] = mini[axis];
+    P[a1] = x;
+    P[a2] = y;
+    N = this->N;
+    pError = gammaBound<Scalar>(3) * (absolute(r.C) + absolute(localt * r.u));
+    pError[axis] = 0;
+    t = localt;
+    return true;
+}
+
+/**
+ * Check if the quad lies on the ray segment (0, tMax).
+ */
+bool Quad::occluded(const Ray& r, double tMax) {
+    Scalar localt = (mini[axis] - r.C[axis]) / r.u[axis];
+    if (!(localt > 0) || localt >= tMax) return false;
+    int a1 = axis == 2 ? 0 : axis + 1;
+    int a2 = a1 == 2 ? 0 : a1 + 1;
+    Scalar x = r.C[a1] + localt * r.u[a1];
+    Scalar y = r.C[a2] + localt * r.u[a2];
+    return x >= mini[a1] && x <= maxi[a1] && y >= mini[a2] && y <= maxi[a2];
+}
+
+BoundingBox Quad::bounds() {
+    return BoundingBox(mini, maxi);
+}
@@ -0,0 +1,34 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_QUAD_H
+#define HELLOWORLD_QUAD_H
+
+#include "Vector.h"
+#include "Ray.h"
+#include "Object.h"
+
+/**
+ * Axis-aligned rectangle, the building block of rooms and boxes.
+ *
+ * The ray is intersected with the plane of the quad with one division, the hit point lies exactly on
+ * that plane, so rays leaving the quad need no offset along the normal.
+ */
+class Quad : public Object {
+public:
+    Quad(const Vector& mini, const Vector& maxi, const Vector& N, const Vector& albedo, bool isMirror=false, bool isTransparent=false);
+    bool intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, double &t);
+    bool occluded(const Ray& r, double tMax);
+    BoundingBox bounds();
+
+    // corners of the quad, equal along axis
+    Vector mini, maxi;
+    // unit normal along axis, points to the lit side
+    Vector N;
+    // axis the quad is perpendicular to
+    int axis;
+};
+
+
+#endif //HELLOWORLD_QUAD_H
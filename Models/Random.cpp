@@ -0,0 +1,41 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "Random.h"
+
+/**
+ * 4D PCG hash (Jarzynski and Olano, "Hash Functions for GPU Rendering").
+ */
+static void pcg4d(uint32_t v[4]) {
+    for (int i = 0; i < 4; i++) {
+        v[i] = v[i] * 1664525u + 1013904223u;
+    }
+    v[0] += v[1]*v[3];
+    v[1] += v[2]*v[0];
+    v[2] += v[0]*v[1];
+    v[3] += v[1]*v[2];
+    for (int i = 0; i < 4; i++) {
+        v[i] ^= v[i] >> 16u;
+    }
+    v[0] += v[1]*v[3];
+    v[1] += v[2]*v[0];
+    v[2] += v[0]*v[1];
+    v[3] += v[1]*v[2];
+}
+
+Sampler::Sampler(uint32_t seed, uint32_t pixel, uint32_t sample) : seed(seed), pixel(pixel), sample(sample) {};
+
+/**
+ * Get the random number of a given bounce and dimension of the current sample.
+ *
+ * @param bounce recursion depth of the path (0 for the camera ray)
+ * @param dimension index of the random number within the bounce, see Sampler::Dimension
+ * @return uniformly distributed random number in (0, 1) with 53 bits of precision
+ */
+double Sampler::get(int bounce, int dimension) const {
+    uint32_t v[4] = {pixel, sample, (uint32_t) bounce, seed * 0x9E3779B9u + (uint32_t) dimension};
+    pcg4d(v);
+    uint64_t bits = ((uint64_t) (v[0] >> 5) << 26) | (v[1] >> 6);
+    return (bits + 0.5) * (1. / 9007199254740992.);
+}
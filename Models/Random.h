@@ -0,0 +1,35 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_RANDOM_H
+#define HELLOWORLD_RANDOM_H
+
+#include <cstdint>
+
+/**
+ * Stateless, counter based random number generator.
+ *
+ * Every random number is a hash of (seed, pixel, sample, bounce, dimension), so no state is shared
+ * between threads and any sample of any pixel can be reproduced in isolation.
+ */
+class Sampler {
+public:
+    // offsets of the random numbers drawn for one bounce, every entry uses two dimensions
+    enum Dimension {
+        PixelDimension = 0,  // jitter inside the pixel (anti-aliasing)
+        LensDimension = 2,   // jitter on the lens (depth of field)
+        LightDimension = 4,  // point on the light source
+        BounceDimension = 6, // direction of the indirect ray
+        RouletteDimension = 8 // Russian roulette, uses one dimension
+    };
+
+    Sampler(uint32_t seed, uint32_t pixel, uint32_t sample);
+    double get(int bounce, int dimension) const;
+
+    uint32_t seed;
+    uint32_t pixel;
+    uint32_t sample;
+};
+
+#endif //HELLOWORLD_RANDOM_H
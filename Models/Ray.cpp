@@ -2,7 +2,42 @@
 // Created by Martin Voigt on 06.01.21.
 //
 
+#include <cmath>
 #include "Ray.h"
 
-Ray::Ray(const Vector& C, const Vector& u): C(C), u(u) {};
+template<typename T>
+RayT<T>::RayT(const VectorT<T>& C, const VectorT<T>& u): C(C), u(u) {};
 
+/**
+ * Origin of a ray leaving a surface, moved just far enough off the surface that it cannot hit it again.
+ *
+ * P is only known up to pError per component, so the true surface lies within that box around P. The origin
+ * is moved along N by the extent of the box in the direction of N, to the side w points to, and the result
+ * is rounded away from the surface.
+ *
+ * @param P point on the surface as computed by the intersection
+ * @param pError bound on the absolute error of every component of P
+ * @param N normal vector of the surface at P
+ * @param w direction of the new ray
+ * @return origin of the new ray
+ */
+template<typename T>
+VectorT<T> offsetRayOrigin(const VectorT<T>& P, const VectorT<T>& pError, const VectorT<T>& N, const VectorT<T>& w) {
+    T d = dot(absolute(N), pError);
+    VectorT<T> offset = d * N;
+    if (dot(w, N) < 0) offset = -offset;
+    VectorT<T> origin = P + offset;
+    for (int i = 0; i < 3; i++) {
+        if (offset[i] > 0) {
+            origin[i] = std::nextafter(origin[i], std::numeric_limits<T>::infinity());
+        } else if (offset[i] < 0) {
+            origin[i] = std::nextafter(origin[i], -std::numeric_limits<T>::infinity());
+        }
+    }
+    return origin;
+}
+
+template class RayT<float>;
+template class RayT<double>;
+template VectorT<float> offsetRayOrigin(const VectorT<float>& P, const VectorT<float>& pError, const VectorT<float>& N, const VectorT<float>& w);
+template VectorT<double> offsetRayOrigin(const VectorT<double>& P, const VectorT<double>& pError, const VectorT<double>& N, const VectorT<double>& w);
@@ -5,17 +5,34 @@
 #ifndef HELLOWORLD_RAY_H
 #define HELLOWORLD_RAY_H
 
+#include <limits>
 #include "Vector.h"
 
-class Ray {
+template<typename T>
+class RayT {
 
 public:
-    Ray(const Vector& C, const Vector& u);
+    RayT(const VectorT<T>& C, const VectorT<T>& u);
     // camera position
-    Vector C;
+    VectorT<T> C;
     // direction vector
-    Vector u;
+    VectorT<T> u;
 };
 
+/**
+ * Bound on the relative rounding error of n consecutive floating-point operations.
+ */
+template<typename T>
+constexpr T gammaBound(int n) {
+    return (n * std::numeric_limits<T>::epsilon() * T(0.5)) / (1 - n * std::numeric_limits<T>::epsilon() * T(0.5));
+}
+
+template<typename T>
+VectorT<T> offsetRayOrigin(const VectorT<T>& P, const VectorT<T>& pError, const VectorT<T>& N, const VectorT<T>& w);
+
+// fraction of a shadow ray left out at the light, the light sample itself is not an occluder
+static const double ShadowEpsilon = 0.0001;
+
+typedef RayT<Scalar> Ray;
 
 #endif //HELLOWORLD_RAY_H
@@ -0,0 +1,31 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "RayPacket.h"
+
+RayPacket::RayPacket(const Vector* origins, const Vector* directions, int count)
+        : origins(origins), directions(directions), count(count) {
+    mask = (1 << count) - 1;
+    coherent = true;
+    for (int lane = 0; lane < RayPacketSize; lane++) {
+        int source = lane < count ? lane : 0;
+        lanes[lane] = WideRay(Ray(origins[source], directions[source]));
+        for (int axis = 0; axis < 3; axis++) {
+            C[axis][lane] = lanes[lane].C[axis];
+            invU[axis][lane] = lanes[lane].invU[axis];
+        }
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        dirIsNeg[axis] = lanes[0].dirIsNeg[axis];
+        minC[axis] = maxC[axis] = C[axis][0];
+        minInvU[axis] = maxInvU[axis] = invU[axis][0];
+        for (int lane = 1; lane < count; lane++) {
+            coherent = coherent && lanes[lane].dirIsNeg[axis] == dirIsNeg[axis];
+            minC[axis] = std::min(minC[axis], C[axis][lane]);
+            maxC[axis] = std::max(maxC[axis], C[axis][lane]);
+            minInvU[axis] = std::min(minInvU[axis], invU[axis][lane]);
+            maxInvU[axis] = std::max(maxInvU[axis], invU[axis][lane]);
+        }
+    }
+}
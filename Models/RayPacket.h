@@ -0,0 +1,152 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_RAYPACKET_H
+#define HELLOWORLD_RAYPACKET_H
+
+#include <vector>
+#include "Vector.h"
+#include "LinearNode.h"
+#include "WideBVH.h"
+
+// number of rays traced together, one per AVX lane
+static const int RayPacketSize = 8;
+
+/**
+ * Group of coherent rays which traverse a BVH together.
+ *
+ * Besides the rays themselves the packet keeps the interval of origins and inverse directions over all
+ * its rays, which bounds the frustum of the packet and lets a node be culled for all rays with one test.
+ */
+class RayPacket {
+public:
+    RayPacket(const Vector* origins, const Vector* directions, int count);
+
+    // rays of the packet, count <= RayPacketSize
+    const Vector* origins;
+    const Vector* directions;
+    int count;
+    // bit mask of the lanes in use
+    int mask;
+    // the rays in the form used by the single precision kernels
+    WideRay lanes[RayPacketSize];
+    // origins and inverse directions as structure of arrays, unused lanes repeat lane 0
+    float C[3][RayPacketSize];
+    float invU[3][RayPacketSize];
+    // true if the direction signs agree on every axis, only then the packet traversal is used
+    bool coherent;
+    int dirIsNeg[3];
+    // bounds of the origins and inverse directions over the packet
+    float minC[3], maxC[3];
+    float minInvU[3], maxInvU[3];
+};
+
+/**
+ * Interval test of the packet frustum against a node.
+ *
+ * @param tMax largest end of the ray segments of the packet
+ * @return false if no ray of the packet can enter the node
+ */
+inline bool intersectFrustum(const LinearNode& node, const RayPacket& p, float tMax) {
+    float tNear = 0, tFar = tMax;
+    for (int axis = 0; axis < 3; axis++) {
+        float nearPlane = p.dirIsNeg[axis] ? node.maxi[axis] : node.mini[axis];
+        float farPlane = p.dirIsNeg[axis] ? node.mini[axis] : node.maxi[axis];
+        // smallest entry and largest exit distance over all origins and directions of the packet
+        float a = (nearPlane - p.maxC[axis]), b = (nearPlane - p.minC[axis]);
+        float lower = std::min(std::min(a*p.minInvU[axis], a*p.maxInvU[axis]), std::min(b*p.minInvU[axis], b*p.maxInvU[axis]));
+        a = (farPlane - p.maxC[axis]);
+        b = (farPlane - p.minC[axis]);
+        float upper = std::max(std::max(a*p.minInvU[axis], a*p.maxInvU[axis]), std::max(b*p.minInvU[axis], b*p.maxInvU[axis]));
+        tNear = std::max(tNear, lower);
+        tFar = std::min(tFar, upper);
+    }
+    return tNear <= tFar * WideSlabTolerance;
+}
+
+/**
+ * Slab test of every ray of the packet against a node.
+ *
+ * @param tMax end of the ray segment of every lane
+ * @param mask lanes to test
+ * @return bit mask of the lanes which enter the node before their tMax
+ */
+inline int intersectLanes(const LinearNode& node, const RayPacket& p, const float* tMax, int mask) {
+#ifdef __AVX__
+    __m256 tNear = _mm256_setzero_ps();
+    __m256 tFar = _mm256_loadu_ps(tMax);
+    for (int axis = 0; axis < 3; axis++) {
+        __m256 C = _mm256_loadu_ps(p.C[axis]);
+        __m256 invU = _mm256_loadu_ps(p.invU[axis]);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.mini[axis]), C), invU);
+        __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maxi[axis]), C), invU);
+        tNear = _mm256_max_ps(tNear, _mm256_min_ps(t1, t2));
+        tFar = _mm256_min_ps(tFar, _mm256_max_ps(t1, t2));
+    }
+    tFar = _mm256_mul_ps(tFar, _mm256_set1_ps(WideSlabTolerance));
+    return mask & _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+#else
+    int hits = 0;
+    for (int lane = 0; lane < RayPacketSize; lane++) {
+        if (!(mask & (1 << lane))) continue;
+        float tNear = 0, tFar = tMax[lane];
+        for (int axis = 0; axis < 3; axis++) {
+            float t1 = (node.mini[axis] - p.C[axis][lane]) * p.invU[axis][lane];
+            float t2 = (node.maxi[axis] - p.C[axis][lane]) * p.invU[axis][lane];
+            tNear = std::max(tNear, std::min(t1, t2));
+            tFar = std::min(tFar, std::max(t1, t2));
+        }
+        if (tNear <= tFar * WideSlabTolerance) hits |= 1 << lane;
+    }
+    return hits;
+#endif
+}
+
+/**
+ * Visit the leaves of a flattened binary BVH hit by any ray of a coherent packet.
+ *
+ * Every stack entry carries the lanes still active in its subtree. A node is first tested against the
+ * frustum of the packet, which culls it for all rays at once, only then the rays are tested one lane each.
+ * The near child is the same for every ray since the direction signs agree.
+ *
+ * @param nodes flattened BVH, nodes[0] is the root
+ * @param p coherent ray packet
+ * @param tMax end of the ray segment of every lane, may be shortened by leaf
+ * @param mask lanes to trace
+ * @param leaf called as leaf(first, count, laneMask) for every leaf reached by the lanes in laneMask
+ */
+template<typename Leaf>
+inline void traversePacketBVH(const std::vector<LinearNode>& nodes, const RayPacket& p, float* tMax, int mask, Leaf leaf) {
+    if (nodes.empty() || !mask) return;
+    struct Entry {
+        int node, mask;
+    };
+    Entry stack[BVHStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = {0, mask};
+
+    while (stackSize > 0) {
+        Entry e = stack[--stackSize];
+        const LinearNode& node = nodes[e.node];
+        float tFar = 0;
+        for (int lane = 0; lane < RayPacketSize; lane++) {
+            if (e.mask & (1 << lane)) tFar = std::max(tFar, tMax[lane]);
+        }
+        if (!intersectFrustum(node, p, tFar)) continue;
+        int lanes = intersectLanes(node, p, tMax, e.mask);
+        if (!lanes) continue;
+
+        if (node.isLeaf()) {
+            leaf(node.offset, node.count, lanes);
+        } else if (p.dirIsNeg[node.axis]) {
+            stack[stackSize++] = {e.node + 1, lanes};
+            stack[stackSize++] = {node.offset, lanes};
+        } else {
+            stack[stackSize++] = {node.offset, lanes};
+            stack[stackSize++] = {e.node + 1, lanes};
+        }
+    }
+}
+
+#endif //HELLOWORLD_RAYPACKET_H
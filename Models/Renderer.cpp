@@ -0,0 +1,135 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "Renderer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "Random.h"
+
+Renderer::Renderer(Scene& scene, int W, int H) : scene(scene), W(W), H(H) {
+    C = Vector(0, 0, 55);
+    fov = 60*M_PI/180;
+    numberOfRays = 100;
+    tileSize = 32;
+    numberOfThreads = 0;
+    seed = 10;
+};
+
+/**
+ * Render the scene into an RGB image of size W*H*3.
+ *
+ * The image is split into square tiles which are handed out one by one to a pool of worker threads.
+ * The random numbers are keyed by pixel and sample, so the result only depends on the seed, and not
+ * on the number of threads, the tile size or the order in which the tiles are finished.
+ *
+ * @param image output buffer, resized to W*H*3
+ */
+void Renderer::render(std::vector<unsigned char>& image) {
+    image.assign(W*H*3, 0);
+
+    int tilesX = (W + tileSize - 1) / tileSize;
+    int tilesY = (H + tileSize - 1) / tileSize;
+    int numberOfTiles = tilesX * tilesY;
+
+    int threads = numberOfThreads;
+    if (threads <= 0) {
+        threads = std::max(1, (int) std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, numberOfTiles);
+
+    std::atomic<int> nextTile(0);
+    std::atomic<int> finishedTiles(0);
+    std::mutex outputMutex;
+
+    auto worker = [&]() {
+        while (true) {
+            int tile = nextTile++;
+            if (tile >= numberOfTiles) break;
+            renderTile(tile, image);
+
+            int finished = ++finishedTiles;
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << finished << " / " << numberOfTiles << " tiles" << std::endl;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++) {
+        pool.push_back(std::thread(worker));
+    }
+    // the calling thread works as well
+    worker();
+    for (int i = 0; i < pool.size(); i++) {
+        pool[i].join();
+    }
+}
+
+void Renderer::renderTile(int tile, std::vector<unsigned char>& image) {
+    int tilesX = (W + tileSize - 1) / tileSize;
+    int iBegin = (tile / tilesX) * tileSize;
+    int jBegin = (tile % tilesX) * tileSize;
+    int iEnd = std::min(H, iBegin + tileSize);
+    int jEnd = std::min(W, jBegin + tileSize);
+
+    for (int i = iBegin; i < iEnd; i++) {
+        for (int j = jBegin; j < jEnd; j++) {
+            writePixel(image, i, j, renderPixel(i, j));
+        }
+    }
+}
+
+/**
+ * Store the gamma corrected color of pixel (i, j), row 0 is the bottom of the image.
+ */
+void Renderer::writePixel(std::vector<unsigned char>& image, int i, int j, const Vector& color) const {
+    // gamma correction
+    double gamma = 2.2;
+
+    image[((H - i - 1)*W + j)* 3 + 0] = std::min(255.0, pow(color[0], 1/gamma));
+    image[((H - i - 1)*W + j)* 3 + 1] = std::min(255.0, pow(color[1], 1/gamma));
+    image[((H - i - 1)*W + j)* 3 + 2] = std::min(255.0, pow(color[2], 1/gamma));
+}
+
+/**
+ * Average the color of numberOfRays camera rays through pixel (i, j).
+ *
+ * Every pixel can be rendered in isolation and gives the same color as in a full render.
+ */
+Vector Renderer::renderPixel(int i, int j) {
+    Vector color(0, 0, 0);
+    for (int k = 0; k < numberOfRays; k++) {
+        Sampler sampler(seed, i*W + j, k);
+        color += scene.getColor(generateRay(i, j, sampler), 0, false, sampler);
+    }
+    return color/numberOfRays;
+}
+
+/**
+ * Create the camera ray of a sample of pixel (i, j).
+ *
+ * The ray is jittered inside the pixel for anti-aliasing and on the lens for depth of field.
+ */
+Ray Renderer::generateRay(int i, int j, const Sampler& sampler) const {
+    double u1 = sampler.get(0, Sampler::PixelDimension);
+    double u2 = sampler.get(0, Sampler::PixelDimension + 1);
+    double x1 = 0.25*cos(2*M_PI*u1)*sqrt(-2 * log(u2));
+    double x2 = 0.25*sin(2*M_PI*u1)*sqrt(-2 * log(u2));
+    u1 = sampler.get(0, Sampler::LensDimension);
+    u2 = sampler.get(0, Sampler::LensDimension + 1);
+    double x3 = 0.01*cos(2*M_PI*u1)*sqrt(-2 * log(u2));
+    double x4 = 0.01*sin(2*M_PI*u1)*sqrt(-2 * log(u2));
+
+    // create ray from pixel coordinates
+    Vector u(j - W/2 + x2 + 0.5, i - H/2 + x1 + 0.5, -W/(2.*tan(fov/2)));
+    u = u.getNormalized();
+    Vector target = C + 55 * u;
+    Vector Cprim = C + Vector(x3, x4, 0);
+    Vector uprime = (target - Cprim).getNormalized();
+
+    return Ray(Cprim, uprime);
+}
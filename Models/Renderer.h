@@ -0,0 +1,41 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_RENDERER_H
+#define HELLOWORLD_RENDERER_H
+
+#include <vector>
+#include "Vector.h"
+#include "Scene.h"
+
+class Renderer {
+public:
+    Renderer(Scene& scene, int W, int H);
+    void render(std::vector<unsigned char>& image);
+    Vector renderPixel(int i, int j);
+    Ray generateRay(int i, int j, const Sampler& sampler) const;
+    void writePixel(std::vector<unsigned char>& image, int i, int j, const Vector& color) const;
+
+    Scene& scene;
+    // image size in pixels
+    int W, H;
+    // camera position
+    Vector C;
+    // camera angle in rad
+    double fov;
+    // samples per pixel
+    int numberOfRays;
+    // edge length of the square tiles the image is split into
+    int tileSize;
+    // number of worker threads, 0 means one per hardware thread
+    int numberOfThreads;
+    // random seed of the render
+    unsigned int seed;
+
+private:
+    void renderTile(int tile, std::vector<unsigned char>& image);
+};
+
+
+#endif //HELLOWORLD_RENDERER_H
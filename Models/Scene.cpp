@@ -3,62 +3,337 @@
 //
 
 #include "Scene.h"
-#include <random>
-static std::default_random_engine engine(10); // random seed = 10
-static std::uniform_real_distribution<double> uniform(0, 1);
+#include <cmath>
+#include "TriangleMesh.h"
+#include "Instance.h"
+#include "Plane.h"
+#include "Quad.h"
 
-Scene::Scene() {};
+Scene::Scene() : lightRadius(0), topLevelObjectCount(0) {
+    minDepth = 3;
+    maxDepth = 5;
+    topLevelSettings.splitMethod = SAHSplit;
+    topLevelSettings.intersectionCost = 2.;
+    topLevelSettings.minLeafSize = 2;
+    topLevelSettings.maxLeafSize = 4;
+    topLevelSettings.numberOfThreads = 1;
+};
+
+/**
+ * Add an object to the scene, the top-level BVH is rebuilt before the next query.
+ */
+void Scene::addObject(Object* object) {
+    objects.push_back(object);
+}
+
+/**
+ * Build the top-level BVH over the world bounds of all objects.
+ *
+ * The material table and the cached light are rebuilt with it. Queries call it automatically when objects
+ * has grown since the last build, it only has to be called by hand when objects are replaced, moved or
+ * change their material.
+ */
+void Scene::buildTopLevel() {
+    std::lock_guard<std::mutex> lock(topLevelMutex);
+    rebuildTopLevel();
+}
+
+/**
+ * Rebuild the top-level BVH if objects were added since the last build.
+ */
+void Scene::updateTopLevel() {
+    if (topLevelObjectCount.load(std::memory_order_acquire) == objects.size()) return;
+    std::lock_guard<std::mutex> lock(topLevelMutex);
+    // another thread may have rebuilt it while this one was waiting
+    if (topLevelObjectCount.load(std::memory_order_acquire) == objects.size()) return;
+    rebuildTopLevel();
+}
+
+/**
+ * Build the top-level BVH together with the primitive and material tables, topLevelMutex has to be held.
+ */
+void Scene::rebuildTopLevel() {
+    materials.clear();
+    std::vector<Primitive> primitives(objects.size());
+    for (int i = 0; i < objects.size(); i++) {
+        Primitive& p = primitives[i];
+        p.type = objects[i]->type;
+        p.object = i;
+        p.material = addMaterial(Material(objects[i]->albedo, objects[i]->isMirror, objects[i]->isTransparent));
+        p.R = 0;
+        if (p.type == SphereObject) {
+            p.O = static_cast<Sphere*>(objects[i])->O;
+            p.R = static_cast<Sphere*>(objects[i])->R;
+        }
+    }
+    if (!primitives.empty()) {
+        lightCenter = primitives[0].O;
+        lightRadius = primitives[0].R;
+    }
+
+    std::vector<BoundingBox> objectBounds;
+    std::vector<Vector> centroids;
+    std::vector<int> boundedObjects;
+    unboundedPrimitives.clear();
+    for (int i = 0; i < objects.size(); i++) {
+        BoundingBox b = objects[i]->bounds();
+        bool finite = true;
+        for (int j = 0; j < 3; j++) {
+            finite = finite && std::isfinite(b.mini[j]) && std::isfinite(b.maxi[j]);
+        }
+        if (!finite) {
+            unboundedPrimitives.push_back(primitives[i]);
+            continue;
+        }
+        boundedObjects.push_back(i);
+        objectBounds.push_back(b);
+        centroids.push_back(b.center());
+    }
+
+    std::vector<int> order;
+    BVHStatistics statistics;
+    BVHBuilder builder(topLevelSettings, objectBounds, centroids);
+    builder.build(topLevelNodes, order, statistics);
+    topLevelPrimitives.resize(order.size());
+    for (int i = 0; i < order.size(); i++) {
+        topLevelPrimitives[i] = primitives[boundedObjects[order[i]]];
+    }
+
+    topLevelObjectCount.store(objects.size(), std::memory_order_release);
+}
+
+/**
+ * @return id of the material in materials, it is appended if no equal material exists yet
+ */
+int Scene::addMaterial(const Material& material) {
+    for (int i = 0; i < materials.size(); i++) {
+        if (materials[i] == material) return i;
+    }
+    materials.push_back(material);
+    return materials.size() - 1;
+}
+
+/**
+ * Intersect a ray with one primitive, dispatched on its type.
+ *
+ * Spheres are intersected from the primitive table, meshes, instances, planes and quads with a direct call
+ * and only other objects through the virtual intersect.
+ */
+inline bool Scene::intersectPrimitive(const Primitive& p, const Ray& r, Vector& P, Vector& N, Vector& pError, double& t) {
+    switch (p.type) {
+        case SphereObject: {
+            Scalar localt;
+            if (!intersectSphere(p.O, p.R, r, P, N, pError, localt)) return false;
+            t = localt;
+            return true;
+        }
+        case MeshObject:
+            return static_cast<TriangleMesh*>(objects[p.object])->TriangleMesh::intersect(r, P, N, pError, t);
+        case InstanceObject:
+            return static_cast<Instance*>(objects[p.object])->Instance::intersect(r, P, N, pError, t);
+        case PlaneObject:
+            return static_cast<Plane*>(objects[p.object])->Plane::intersect(r, P, N, pError, t);
+        case QuadObject:
+            return static_cast<Quad*>(objects[p.object])->Quad::intersect(r, P, N, pError, t);
+        default:
+            return objects[p.object]->intersect(r, P, N, pError, t);
+    }
+}
+
+/**
+ * Check if one primitive lies on the ray segment (0, tMax), dispatched on its type.
+ */
+inline bool Scene::occludedPrimitive(const Primitive& p, const Ray& r, double tMax) {
+    switch (p.type) {
+        case SphereObject:
+            return occludedSphere(p.O, p.R, r, tMax);
+        case MeshObject:
+            return static_cast<TriangleMesh*>(objects[p.object])->TriangleMesh::occluded(r, tMax);
+        case InstanceObject:
+            return static_cast<Instance*>(objects[p.object])->Instance::occluded(r, tMax);
+        case PlaneObject:
+            return static_cast<Plane*>(objects[p.object])->Plane::occluded(r, tMax);
+        case QuadObject:
+            return static_cast<Quad*>(objects[p.object])->Quad::occluded(r, tMax);
+        default:
+            return objects[p.object]->occluded(r, tMax);
+    }
+}
 
 /**
  * Check if a given ray intersects an object in a given scene.
  *
  * If the ray intersects multiple objects in the scene, we take the object which has the
- * shortest distance to the camera (smallest t value).
+ * shortest distance to the camera (smallest t value). The objects are found through the top-level BVH,
+ * so only objects whose bounds the ray enters before the closest hit so far are tested.
  *
  * @param r incoming ray
  * @param P intersection point
  * @param N normal vector of the sphere at the intersection point
+ * @param pError bound on the absolute error of P, used to offset the rays leaving P
  * @param albedo color of the sphere the ray intersects
  * @param mirror return value which indicates if the object is a mirror
  * @param transparency indicates if the object is transparent
  * @param t indicates at which point of the ray the intersection happens
  * @return true if the input ray intersects with at least one of the spheres in the scene
  */
-bool Scene::intersect(const Ray& r, Vector& P, Vector& N, Vector &albedo, bool &mirror, bool &transparency, double &t, int& objectid) {
+bool Scene::intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, Vector &albedo, bool &mirror, bool &transparency, double &t, int& objectid) {
+    updateTopLevel();
     t = 1E10;
     bool hasInter = false;
 
-    for (int i = 0; i<objects.size(); i++) {
-        Vector localP, localN;
+    auto test = [&](const Primitive& p) {
+        Vector localP, localN, localError;
         double localt;
 
         // localt < t assures that the object is at the front of the scene
-        if (objects[i]->intersect(r, localP, localN, localt) && localt < t) {
+        if (intersectPrimitive(p, r, localP, localN, localError, localt) && localt < t) {
+            const Material& material = materials[p.material];
             t = localt;
             hasInter = true;
-            albedo = objects[i]->albedo;
+            albedo = material.albedo;
             P = localP;
             N = localN;
-            mirror = objects[i]->isMirror;
-            transparency = objects[i]->isTransparent;
-            objectid = i;
+            pError = localError;
+            mirror = material.isMirror;
+            transparency = material.isTransparent;
+            objectid = p.object;
         }
+    };
+
+    for (int k = 0; k < unboundedPrimitives.size(); k++) {
+        test(unboundedPrimitives[k]);
     }
+    traverseBVH(topLevelNodes, r, t, [&](int first, int count) {
+        for (int k = first; k < first + count; k++) {
+            test(topLevelPrimitives[k]);
+        }
+        return false;
+    });
 
     return hasInter;
 }
 
-Vector random_cos(const Vector& N) {
-    double u1 = uniform(engine);
-    double u2 = uniform(engine);
+/**
+ * Intersect up to RayPacketSize rays with the scene at once, with the same results as intersect.
+ *
+ * Coherent rays, such as the camera rays of one pixel, traverse the top-level BVH and the mesh BVHs as
+ * a packet. Packets whose direction signs differ fall back to one intersect call per ray.
+ *
+ * @param origins origins of the rays
+ * @param directions directions of the rays
+ * @param count number of rays, at most RayPacketSize
+ * @param hit set to true for the rays which intersect an object, the other outputs are as in intersect
+ */
+void Scene::intersectPacket(const Vector* origins, const Vector* directions, int count, Vector* P, Vector* N, Vector* pError,
+                            Vector* albedo, bool* mirror, bool* transparency, double* t, int* objectid, bool* hit) {
+    updateTopLevel();
+    RayPacket packet(origins, directions, count);
+    if (!packet.coherent) {
+        for (int lane = 0; lane < count; lane++) {
+            hit[lane] = intersect(Ray(origins[lane], directions[lane]), P[lane], N[lane], pError[lane], albedo[lane],
+                                  mirror[lane], transparency[lane], t[lane], objectid[lane]);
+        }
+        return;
+    }
+
+    float tCull[RayPacketSize];
+    for (int lane = 0; lane < RayPacketSize; lane++) {
+        tCull[lane] = 1E10;
+        if (lane < count) {
+            t[lane] = 1E10;
+            hit[lane] = false;
+        }
+    }
+
+    auto test = [&](const Primitive& p, int mask) {
+        int hits = 0;
+        if (p.type == MeshObject) {
+            hits = static_cast<TriangleMesh*>(objects[p.object])->TriangleMesh::intersectPacket(packet, mask, t, P, N, pError);
+        } else {
+            for (int lane = 0; lane < count; lane++) {
+                if (!(mask & (1 << lane))) continue;
+                Vector localP, localN, localError;
+                double localt;
+                if (intersectPrimitive(p, Ray(origins[lane], directions[lane]), localP, localN, localError, localt) && localt < t[lane]) {
+                    t[lane] = localt;
+                    P[lane] = localP;
+                    N[lane] = localN;
+                    pError[lane] = localError;
+                    hits |= 1 << lane;
+                }
+            }
+        }
+        const Material& material = materials[p.material];
+        for (int lane = 0; lane < count; lane++) {
+            if (!(hits & (1 << lane))) continue;
+            hit[lane] = true;
+            albedo[lane] = material.albedo;
+            mirror[lane] = material.isMirror;
+            transparency[lane] = material.isTransparent;
+            objectid[lane] = p.object;
+            tCull[lane] = (float) t[lane];
+        }
+    };
+
+    for (int k = 0; k < unboundedPrimitives.size(); k++) {
+        test(unboundedPrimitives[k], packet.mask);
+    }
+    traversePacketBVH(topLevelNodes, packet, tCull, packet.mask, [&](int first, int objectCount, int lanes) {
+        for (int k = first; k < first + objectCount; k++) {
+            test(topLevelPrimitives[k], lanes);
+        }
+    });
+}
+
+/**
+ * Check if any object of the scene lies on the ray segment (0, tMax).
+ *
+ * Used for shadow rays: it returns at the first object found and computes no surface data.
+ *
+ * @param r incoming ray
+ * @param tMax end of the segment
+ * @return true if the segment is blocked
+ */
+bool Scene::occluded(const Ray& r, double tMax) {
+    updateTopLevel();
+    for (int k = 0; k < unboundedPrimitives.size(); k++) {
+        if (occludedPrimitive(unboundedPrimitives[k], r, tMax)) {
+            return true;
+        }
+    }
+    bool blocked = false;
+    traverseBVH(topLevelNodes, r, tMax, [&](int first, int count) {
+        for (int k = first; k < first + count; k++) {
+            if (occludedPrimitive(topLevelPrimitives[k], r, tMax)) {
+                blocked = true;
+                return true;
+            }
+        }
+        return false;
+    });
+    return blocked;
+}
+
+/**
+ * Sample a direction around N with a cosine weighted distribution.
+ *
+ * @param N normal vector
+ * @param u1 first uniform random number in (0, 1)
+ * @param u2 second uniform random number in (0, 1)
+ * @return random direction in the hemisphere of N
+ */
+Vector random_cos(const Vector& N, double u1, double u2) {
     double x = cos(2*M_PI*u1)*sqrt(-2 * log(u2));
     double y = sin(2*M_PI*u1)*sqrt(-2 * log(u2));
     double z = sqrt(u2);
+    // the tangent drops the smallest component of N, so it cannot vanish for axis-aligned normals
     Vector T1;
-    if (N[0] < N[1] && N[0] < N[2]) {
+    Vector absN = absolute(N);
+    if (absN[0] <= absN[1] && absN[0] <= absN[2]) {
         T1 = Vector(0, N[2], -N[1]);
     } else {
-        if (N[1] < N[2] && N[1] < N[0]) {
+        if (absN[1] <= absN[2]) {
             T1 = Vector(N[2], 0, -N[0]);
         } else {
 
@@ -73,99 +348,145 @@ Vector random_cos(const Vector& N) {
 /**
  * Get color of object in scene which intersects with the incoming ray.
  *
- * If the object is a mirror or transparent, we calculate the new ray direction and call the function recursively.
+ * The path is followed iteratively: every bounce multiplies the throughput by the albedo of the surface,
+ * light found along the way is weighted with the throughput at that point.
  *
  * @param r incoming ray
- * @param rebound upper bound for recursion calls
+ * @param rebound number of bounces before r, paths end after maxDepth bounces
+ * @param lastDiffuse indicates if the ray was scattered by a diffuse surface
+ * @param sampler random numbers of the current sample
  * @return color of the object the ray intersects with
  */
-Vector Scene::getColor(const Ray& r, int rebound, bool lastDiffuse) {
-    if (rebound > 5) {
-        return Vector(0., 0., 0.);
+Vector Scene::getColor(const Ray& r, int rebound, bool lastDiffuse, const Sampler& sampler) {
+    PathState path;
+    path.rebound = rebound;
+    path.lastDiffuse = lastDiffuse;
+    Ray ray = r;
+
+    for (; path.rebound <= maxDepth; path.rebound++) {
+        Hit hit;
+        double t;
+        if (!this->intersect(ray, hit.P, hit.N, hit.pError, hit.albedo, hit.mirror, hit.transparent, t, hit.objectid)) break;
+
+        Ray next = ray, shadowRay = ray;
+        double shadowDistance;
+        Vector shadowContribution;
+        bool alive = shade(ray, hit, path, sampler, next, shadowRay, shadowDistance, shadowContribution);
+        if (shadowDistance > 0 && !this->occluded(shadowRay, shadowDistance)) {
+            path.radiance += shadowContribution;
+        }
+        if (!alive) break;
+        ray = next;
     }
+    return path.radiance;
+}
 
-    Vector P, N, albedo;
-    double t;
-    bool mirror, transparent;
-    int objectid;
-    bool inter = this->intersect(r, P, N, albedo, mirror, transparent, t, objectid);
-    Vector color(0, 0, 0);
+/**
+ * Evaluate one bounce of a path at the point where its ray hits an object.
+ *
+ * Light emitted by the hit object is added to radiance. For diffuse surfaces a shadow ray towards a random
+ * point of the light is set up, the caller traces it and adds shadowContribution if it is not blocked.
+ * After minDepth bounces the path is continued only with probability max(throughput), and the throughput
+ * of the surviving paths is divided by that probability, which keeps the estimate unbiased.
+ * New rays start at P moved off the surface by the error bound pError, so they do not hit it again.
+ *
+ * @param r ray of the path
+ * @param hit closest hit of r
+ * @param path throughput, radiance and lastDiffuse are updated for next, rebound is left to the caller
+ * @param sampler random numbers of the current sample
+ * @param next ray the path continues with
+ * @param shadowRay ray from the hit point towards the light
+ * @param shadowDistance length of the shadow ray, 0 if there is none
+ * @param shadowContribution light added by the shadow ray if it is not blocked
+ * @return true if the path continues with next
+ */
+bool Scene::shade(const Ray& r, const Hit& hit, PathState& path, const Sampler& sampler,
+                  Ray& next, Ray& shadowRay, double& shadowDistance, Vector& shadowContribution) {
+    const Vector& P = hit.P;
+    const Vector& N = hit.N;
+    const Vector& pError = hit.pError;
+    int rebound = path.rebound;
+    Vector& throughput = path.throughput;
+    shadowDistance = 0;
 
-    if (inter) {
+    if (hit.objectid == 0) {
+        if (rebound == 0 || !path.lastDiffuse) {
+            double R2 = lightRadius*lightRadius;
+            path.radiance += throughput * (Vector(I, I, I) / (4 * M_PI * M_PI * R2));
+        }
+        return false;
+    }
 
-        if (objectid == 0) {
-            if (rebound == 0 || !lastDiffuse) {
-                double R2 = pow(dynamic_cast<Sphere *>(objects[0])->R, 2);
-                return Vector(I, I, I) / (4 * M_PI * M_PI * R2);
-            }
-            else
-                return Vector(0., 0., 0.);
-        }
-
-        if (mirror) {
-            // use the formula for reflection of vectors
-            Vector reflectedDir = r.u - 2*dot(r.u, N)*N;
-            Ray reflectedRay(P + 0.00001*N, reflectedDir);
-            return getColor(reflectedRay, rebound + 1, false);
-        } 
-        else {
-            if (transparent) {
-                // if the body is transparent we use Snell's law
-                // n1 and n2 are the phase velocities in the two media
-                double n1 = 1, n2 = 1.4;
-                Vector N2 = N;
-
-                // normal vector and incoming ray need to have the same orientation
-                if (dot(r.u, N) > 0) {
-                    std::swap(n1, n2);
-                    N2 = -N;
-                }
-                // tangential component
-                Vector Tt = n1 / n2 * (r.u - dot(r.u, N2) * N2);
-                double rad = 1 - pow(n1 / n2, 2) * (1 - pow(dot(r.u, N2), 2));
-                if (rad < 0) { // the square root is complex which means we have total reflection
-                    Vector reflectedDir = r.u - 2 * dot(r.u, N) * N;
-                    Ray reflectedRay(P + 0.001 * N, reflectedDir);
-                    return getColor(reflectedRay, rebound + 1, false);
-                }
-                // normal component
-                Vector Tn = -sqrt(rad) * N2;
+    if (hit.mirror) {
+        // use the formula for reflection of vectors
+        Vector reflectedDir = r.u - 2*dot(r.u, N)*N;
+        next = Ray(offsetRayOrigin(P, pError, N, reflectedDir), reflectedDir);
+        path.lastDiffuse = false;
+    }
+    else if (hit.transparent) {
+        // if the body is transparent we use Snell's law
+        // n1 and n2 are the phase velocities in the two media
+        double n1 = 1, n2 = 1.4;
+        Vector N2 = N;
 
-                // the refracted vector is made up of the tangential and normal component
-                Vector refractedDir = Tt + Tn;
-                Ray refractedRay(P - 0.0001 * N2, refractedDir);
-                return getColor(refractedRay, rebound + 1, false);
-            }
-            // direct lighting
-            Vector PL = L - P;
-            PL = PL.getNormalized();
-            Vector w = random_cos(-PL);
-            Vector xprime = w * dynamic_cast<Sphere *>(objects[0])->R + dynamic_cast<Sphere *>(objects[0])->O;
-            Vector Pxprime = xprime - P;
-            double d = sqrt(Pxprime.sqrNorm());
-            Pxprime = Pxprime / d;
-
-            Vector shadowP, shadowN, shadowAlbedo;
-            double shadowt;
-            bool shadowMirror, shadowTransp;
-            // int objectid;
-            Ray shadowRay(P + 0.00001 * N, Pxprime);
-            bool shadowInter = this->intersect(shadowRay, shadowP, shadowN, shadowAlbedo, shadowMirror,
-                                               shadowTransp, shadowt, objectid);
-            if (shadowInter && shadowt < d - 0.0001) {
-                color = Vector(0., 0., 0.);
-            } else {
-                double R2 = pow(dynamic_cast<Sphere *>(objects[0])->R, 2);
-                double proba = std::max(0., dot(-PL, w)) / (M_PI * R2);
-                double J = std::max(0., dot(w, -Pxprime)) / (d * d);
-                color = I / (4 * M_PI * M_PI * R2) * albedo / M_PI * std::max(0., dot(N, Pxprime)) * J / proba;
-            }
+        // normal vector and incoming ray need to have the same orientation
+        if (dot(r.u, N) > 0) {
+            std::swap(n1, n2);
+            N2 = -N;
+        }
+        // tangential component
+        Vector Tt = n1 / n2 * (r.u - dot(r.u, N2) * N2);
+        double rad = 1 - pow(n1 / n2, 2) * (1 - pow(dot(r.u, N2), 2));
+        if (rad < 0) { // the square root is complex which means we have total reflection
+            Vector reflectedDir = r.u - 2 * dot(r.u, N) * N;
+            next = Ray(offsetRayOrigin(P, pError, N, reflectedDir), reflectedDir);
+        } else {
+            // normal component
+            Vector Tn = -sqrt(rad) * N2;
 
-            // indirect lighting
-            Vector wiDir = random_cos(N);
-            Ray wiRay(P + 0.00001*N, wiDir);
-            color += albedo*getColor(wiRay, rebound + 1, true);
+            // the refracted vector is made up of the tangential and normal component
+            Vector refractedDir = Tt + Tn;
+            next = Ray(offsetRayOrigin(P, pError, N, refractedDir), refractedDir);
         }
+        path.lastDiffuse = false;
     }
-    return color;
-}
\ No newline at end of file
+    else {
+        // direct lighting
+        Vector PL = L - P;
+        PL = PL.getNormalized();
+        Vector w = random_cos(-PL, sampler.get(rebound, Sampler::LightDimension),
+                              sampler.get(rebound, Sampler::LightDimension + 1));
+        Vector xprime = w * lightRadius + lightCenter;
+        Vector Pxprime = xprime - P;
+        double d = sqrt(Pxprime.sqrNorm());
+        Pxprime = Pxprime / d;
+        // both ends of the shadow ray are moved off their surface, the light sample is bounded like a sphere hit
+        Vector lightError = gammaBound<Scalar>(5) * absolute(w * lightRadius) + gammaBound<Scalar>(1) * absolute(xprime);
+        Vector shadowOrigin = offsetRayOrigin(P, pError, N, Pxprime);
+        Vector shadowEnd = offsetRayOrigin(xprime, lightError, w, -Pxprime);
+        Vector shadowDir = shadowEnd - shadowOrigin;
+        double shadowLength = sqrt(shadowDir.sqrNorm());
+
+        double R2 = lightRadius*lightRadius;
+        double proba = std::max<double>(0., dot(-PL, w)) / (M_PI * R2);
+        double J = std::max<double>(0., dot(w, -Pxprime)) / (d * d);
+        shadowRay = Ray(shadowOrigin, shadowDir / shadowLength);
+        shadowDistance = shadowLength * (1 - ShadowEpsilon);
+        shadowContribution = throughput * (I / (4 * M_PI * M_PI * R2) * hit.albedo / M_PI * std::max<double>(0., dot(N, Pxprime)) * J / proba);
+
+        // indirect lighting
+        Vector wiDir = random_cos(N, sampler.get(rebound, Sampler::BounceDimension),
+                                 sampler.get(rebound, Sampler::BounceDimension + 1));
+        next = Ray(offsetRayOrigin(P, pError, N, wiDir), wiDir);
+        throughput = throughput * hit.albedo;
+        path.lastDiffuse = true;
+    }
+
+    if (rebound + 1 > maxDepth) return false;
+    if (rebound + 1 > minDepth) {
+        double q = std::min<double>(1., std::max(throughput[0], std::max(throughput[1], throughput[2])));
+        if (sampler.get(rebound, Sampler::RouletteDimension) >= q) return false;
+        throughput = throughput / q;
+    }
+    return true;
+}
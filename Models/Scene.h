@@ -5,16 +5,34 @@
 #ifndef HELLOWORLD_SCENE_H
 #define HELLOWORLD_SCENE_H
 
+#include <atomic>
+#include <mutex>
 #include <vector>
 #include "Vector.h"
 #include "Ray.h"
 #include "Sphere.h"
+#include "Random.h"
+#include "LinearNode.h"
+#include "BVHBuilder.h"
+#include "Material.h"
+#include "Primitive.h"
+#include "Hit.h"
+#include "PathState.h"
+
+Vector random_cos(const Vector& N, double u1, double u2);
 
 class Scene {
 public:
     Scene();
-    bool intersect(const Ray& r, Vector& P, Vector& N, Vector &albedo, bool &mirror, bool &transparency, double &t, int& objectid);//, Object* &s);
-    Vector getColor(const Ray& r, int rebound, bool lastDiffuse);
+    void addObject(Object* object);
+    void buildTopLevel();
+    bool intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, Vector &albedo, bool &mirror, bool &transparency, double &t, int& objectid);//, Object* &s);
+    void intersectPacket(const Vector* origins, const Vector* directions, int count, Vector* P, Vector* N, Vector* pError,
+                         Vector* albedo, bool* mirror, bool* transparency, double* t, int* objectid, bool* hit);
+    bool occluded(const Ray& r, double tMax);
+    Vector getColor(const Ray& r, int rebound, bool lastDiffuse, const Sampler& sampler);
+    bool shade(const Ray& r, const Hit& hit, PathState& path, const Sampler& sampler,
+               Ray& next, Ray& shadowRay, double& shadowDistance, Vector& shadowContribution);
 
     // list of objects in the scene
     std::vector<Object*> objects;
@@ -22,6 +40,33 @@ public:
     Vector L;
     // light intensity
     double I;
+    // bounces after which Russian roulette may terminate a path
+    int minDepth;
+    // bounces after which a path is always terminated
+    int maxDepth;
+    // settings of the top-level BVH over the objects
+    BVHSettings topLevelSettings;
+    // distinct materials of the objects, filled with the top-level BVH
+    std::vector<Material> materials;
+
+private:
+    void updateTopLevel();
+    void rebuildTopLevel();
+    int addMaterial(const Material& material);
+    bool intersectPrimitive(const Primitive& p, const Ray& r, Vector& P, Vector& N, Vector& pError, double& t);
+    bool occludedPrimitive(const Primitive& p, const Ray& r, double tMax);
+
+    // top-level BVH over the world bounds of the objects, leaves reference ranges of topLevelPrimitives
+    std::vector<LinearNode> topLevelNodes;
+    std::vector<Primitive> topLevelPrimitives;
+    // objects without finite bounds, tested against every ray
+    std::vector<Primitive> unboundedPrimitives;
+    // center and radius of the light source objects[0], which has to be a sphere
+    Vector lightCenter;
+    double lightRadius;
+    // number of objects the top-level BVH was built for
+    std::atomic<size_t> topLevelObjectCount;
+    std::mutex topLevelMutex;
 };
 
 
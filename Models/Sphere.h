@@ -5,26 +5,115 @@
 #ifndef HELLOWORLD_SPHERE_H
 #define HELLOWORLD_SPHERE_H
 
+#include <cmath>
+#include <limits>
 #include "Vector.h"
 #include "Ray.h"
 #include "Object.h"
 
 class Sphere : public Object {
 public:
-    Sphere(const Vector& O, double R, const Vector& albedo, bool isMirror=false, bool isTransparent=false);
-    bool intersect(const Ray& r, Vector& P, Vector& N, double &t);
+    Sphere(const Vector& O, Scalar R, const Vector& albedo, bool isMirror=false, bool isTransparent=false);
+    bool intersect(const Ray& r, Vector& P, Vector& N, Vector& pError, double &t);
+    bool occluded(const Ray& r, double tMax);
+    BoundingBox bounds();
 
     // center of the sphere
     Vector O;
     // radius of the sphere
-    double R;
-    // color of the sphere
-    Vector albedo;
-    // a mirror sphere is a sphere which reflects all incoming rays
-    bool isMirror;
-    // a transparent sphere uses Snell's law for incoming rays
-    bool isTransparent;
+    Scalar R;
 };
 
+/**
+ * Smallest distance at which a hit with the sphere is accepted.
+ *
+ * The quadratic loses about (|C - O| + R) * epsilon of absolute precision, in float this easily exceeds
+ * the offset of a ray leaving the sphere, which would then hit the sphere again right at its origin.
+ */
+template<typename T>
+inline T sphereEpsilon(const VectorT<T>& CO, T R, T a) {
+    return 16 * std::numeric_limits<T>::epsilon() * (sqrt(CO.sqrNorm()) + R) / sqrt(a);
+}
+
+/**
+ * Check if a given ray intersects with the sphere of center O and radius R.
+ *
+ * Kept inline so that the scene can intersect spheres straight from its primitive table.
+ *
+ * The hit point is projected back onto the sphere, which bounds its error independently of t.
+ *
+ * @param r incoming ray
+ * @param P intersection point
+ * @param N normal vector of sphere at intersection point
+ * @param pError bound on the absolute error of P
+ * @param t length of direction vector to intersect with the sphere
+ * @return true if the input ray intersects with the sphere, false otherwise
+ */
+template<typename T>
+inline bool intersectSphere(const VectorT<T>& O, T R, const RayT<T>& r, VectorT<T>& P, VectorT<T>& N, VectorT<T>& pError, T &t) {
+    // if the ray intersects with the sphere, the following equation is satisfied
+    // ||u||^2*t^2 + 2t*<u, C-O> + ||O-C||^2 - R^2 = 0
+    // in the following we represent this equation using the general form of quadratic equations
+    // a*t^2 + b*t + c = 0
+    // u is not necessarily normalized (e.g. diffuse bounces), t has to stay the ray parameter for the scene BVH
+    VectorT<T> CO = r.C - O;
+    T a = dot(r.u, r.u);
+    T b = 2*dot(r.u, CO);
+    T c = CO.sqrNorm() - R*R;
+
+    T discriminant = b*b - 4*a*c;
+
+    if (discriminant < 0) return false;
+
+    T sqDelta = sqrt(discriminant);
+    T t2 = (-b + sqDelta) / (2*a);
+    T tMin = sphereEpsilon(CO, R, a);
+
+    if (t2 < tMin) return false;
+
+    T t1 = (-b - sqDelta) / (2*a);
+    if (t1 > tMin)
+        t = t1;
+    else
+        t = t2;
+
+    VectorT<T> OP = multiplyAdd(t, r.u, CO);
+    OP = OP * (R / std::sqrt(OP.sqrNorm()));
+    P = O + OP;
+    N = OP / R;
+    pError = gammaBound<T>(5) * absolute(OP) + gammaBound<T>(1) * absolute(P);
+
+    return true;
+}
+
+/**
+ * Check if the sphere of center O and radius R lies on the ray segment (0, tMax), without computing P and N.
+ *
+ * @param r incoming ray
+ * @param tMax end of the segment
+ * @return true if the segment is blocked by the sphere
+ */
+template<typename T>
+inline bool occludedSphere(const VectorT<T>& O, T R, const RayT<T>& r, double tMax) {
+    VectorT<T> CO = r.C - O;
+    T a = dot(r.u, r.u);
+    T b = 2*dot(r.u, CO);
+    T c = CO.sqrNorm() - R*R;
+
+    T discriminant = b*b - 4*a*c;
+
+    if (discriminant < 0) return false;
+
+    T sqDelta = sqrt(discriminant);
+    T t2 = (-b + sqDelta) / (2*a);
+    T tMin = sphereEpsilon(CO, R, a);
+
+    if (t2 < tMin) return false;
+
+    T t1 = (-b - sqDelta) / (2*a);
+    if (t1 > tMin)
+        return t1 < tMax;
+    return t2 < tMax;
+}
 
 #endif //HELLOWORLD_SPHERE_H
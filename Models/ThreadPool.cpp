@@ -0,0 +1,59 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "ThreadPool.h"
+
+/**
+ * @param numberOfThreads threads including the calling one, 0 means one per hardware thread
+ */
+ThreadPool::ThreadPool(int numberOfThreads)
+        : numberOfThreads(resolveThreadCount(numberOfThreads)), task(nullptr), generation(0), pending(0), stopping(false) {
+    for (int t = 1; t < this->numberOfThreads; t++) {
+        workers.push_back(std::thread(&ThreadPool::work, this, t));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (int i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+/**
+ * Call task(thread) once on every thread of the pool and wait until all calls have returned.
+ */
+void ThreadPool::run(const std::function<void(int)>& task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        pending = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    task(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]() { return pending == 0; });
+}
+
+void ThreadPool::work(int thread) {
+    long long done = 0;
+    while (true) {
+        const std::function<void(int)>* current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != done; });
+            if (stopping) return;
+            done = generation;
+            current = task;
+        }
+        (*current)(thread);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) finished.notify_one();
+    }
+}
@@ -0,0 +1,68 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_THREADPOOL_H
+#define HELLOWORLD_THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Parallel.h"
+
+/**
+ * Fixed set of worker threads which run one task after the other, for loops which run too often to start
+ * threads every time.
+ *
+ * Thread 0 is the thread which calls run, the others are started once by the constructor. Chunk c of a
+ * parallelFor always runs on thread c, so per-thread state such as a PerfCounter can be indexed by chunk.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(int numberOfThreads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+    int size() const { return numberOfThreads; }
+    void run(const std::function<void(int)>& task);
+    template<typename F>
+    int parallelFor(int beginning, int end, F f, int grainSize = DefaultGrainSize);
+
+private:
+    void work(int thread);
+
+    int numberOfThreads;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    // task of the current round, the workers start a round when generation changes
+    const std::function<void(int)>* task;
+    long long generation;
+    // workers which have not finished the current round
+    int pending;
+    bool stopping;
+};
+
+/**
+ * Same as the free parallelFor, with the same chunks, but on the threads of the pool.
+ *
+ * @return number of chunks
+ */
+template<typename F>
+int ThreadPool::parallelFor(int beginning, int end, F f, int grainSize) {
+    int count = end - beginning;
+    int chunks = chunkCount(count, numberOfThreads, grainSize);
+    if (chunks == 1) {
+        f(beginning, end, 0);
+        return 1;
+    }
+    run([&](int thread) {
+        if (thread >= chunks) return;
+        f(beginning + (int) ((long long) count * thread / chunks), beginning + (int) ((long long) count * (thread + 1) / chunks), thread);
+    });
+    return chunks;
+}
+
+#endif //HELLOWORLD_THREADPOOL_H
@@ -0,0 +1,151 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <cmath>
+#include "Transform.h"
+#include "Ray.h"
+
+/**
+ * Create the identity.
+ */
+Transform::Transform() {
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            m[i][j] = i == j ? 1 : 0;
+        }
+    }
+};
+
+/**
+ * Create the transform which maps the unit axes to xAxis, yAxis and zAxis and the origin to translation.
+ */
+Transform::Transform(const Vector& xAxis, const Vector& yAxis, const Vector& zAxis, const Vector& translation) {
+    for (int i = 0; i < 3; i++) {
+        m[i][0] = xAxis[i];
+        m[i][1] = yAxis[i];
+        m[i][2] = zAxis[i];
+        m[i][3] = translation[i];
+    }
+};
+
+Transform Transform::translation(const Vector& T) {
+    return Transform(Vector(1, 0, 0), Vector(0, 1, 0), Vector(0, 0, 1), T);
+}
+
+Transform Transform::scaling(const Vector& s) {
+    return Transform(Vector(s[0], 0, 0), Vector(0, s[1], 0), Vector(0, 0, s[2]), Vector(0, 0, 0));
+}
+
+/**
+ * Rotation around an axis through the origin (Rodrigues' formula).
+ *
+ * @param axis rotation axis, does not need to be normalized
+ * @param angle angle in rad
+ */
+Transform Transform::rotation(const Vector& axis, double angle) {
+    Vector a = axis / sqrt(dot(axis, axis));
+    double c = cos(angle), s = sin(angle);
+    Transform r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            r.m[i][j] = (1 - c) * a[i] * a[j] + (i == j ? c : 0);
+        }
+    }
+    r.m[0][1] -= s * a[2];
+    r.m[0][2] += s * a[1];
+    r.m[1][0] += s * a[2];
+    r.m[1][2] -= s * a[0];
+    r.m[2][0] -= s * a[1];
+    r.m[2][1] += s * a[0];
+    return r;
+}
+
+/**
+ * @return transform applying b first and this second
+ */
+Transform Transform::operator*(const Transform& b) const {
+    Transform r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i][j] = m[i][0]*b.m[0][j] + m[i][1]*b.m[1][j] + m[i][2]*b.m[2][j] + (j == 3 ? m[i][3] : 0);
+        }
+    }
+    return r;
+}
+
+Transform Transform::inverse() const {
+    // inverse of the linear part through the adjugate
+    double det = m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+               - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+               + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+    double invDet = 1. / det;
+    Transform r;
+    r.m[0][0] = (m[1][1]*m[2][2] - m[1][2]*m[2][1]) * invDet;
+    r.m[0][1] = (m[0][2]*m[2][1] - m[0][1]*m[2][2]) * invDet;
+    r.m[0][2] = (m[0][1]*m[1][2] - m[0][2]*m[1][1]) * invDet;
+    r.m[1][0] = (m[1][2]*m[2][0] - m[1][0]*m[2][2]) * invDet;
+    r.m[1][1] = (m[0][0]*m[2][2] - m[0][2]*m[2][0]) * invDet;
+    r.m[1][2] = (m[0][2]*m[1][0] - m[0][0]*m[1][2]) * invDet;
+    r.m[2][0] = (m[1][0]*m[2][1] - m[1][1]*m[2][0]) * invDet;
+    r.m[2][1] = (m[0][1]*m[2][0] - m[0][0]*m[2][1]) * invDet;
+    r.m[2][2] = (m[0][0]*m[1][1] - m[0][1]*m[1][0]) * invDet;
+    // the translation is mapped back by the inverse linear part
+    for (int i = 0; i < 3; i++) {
+        r.m[i][3] = -(r.m[i][0]*m[0][3] + r.m[i][1]*m[1][3] + r.m[i][2]*m[2][3]);
+    }
+    return r;
+}
+
+Vector Transform::applyToPoint(const Vector& p) const {
+    return Vector(m[0][0]*p[0] + m[0][1]*p[1] + m[0][2]*p[2] + m[0][3],
+                  m[1][0]*p[0] + m[1][1]*p[1] + m[1][2]*p[2] + m[1][3],
+                  m[2][0]*p[0] + m[2][1]*p[1] + m[2][2]*p[2] + m[2][3]);
+}
+
+/**
+ * Transform a point that already carries an error and bound the error of the result.
+ *
+ * @param p point to transform
+ * @param pError bound on the absolute error of p
+ * @param absError bound on the absolute error of the transformed point
+ * @return transformed point
+ */
+Vector Transform::applyToPoint(const Vector& p, const Vector& pError, Vector& absError) const {
+    const double g = gammaBound<Scalar>(3);
+    for (int i = 0; i < 3; i++) {
+        absError[i] = g * (std::abs(m[i][0]*p[0]) + std::abs(m[i][1]*p[1]) + std::abs(m[i][2]*p[2]) + std::abs(m[i][3]))
+                    + (1 + g) * (std::abs(m[i][0])*pError[0] + std::abs(m[i][1])*pError[1] + std::abs(m[i][2])*pError[2]);
+    }
+    return applyToPoint(p);
+}
+
+Vector Transform::applyToVector(const Vector& v) const {
+    return Vector(m[0][0]*v[0] + m[0][1]*v[1] + m[0][2]*v[2],
+                  m[1][0]*v[0] + m[1][1]*v[1] + m[1][2]*v[2],
+                  m[2][0]*v[0] + m[2][1]*v[1] + m[2][2]*v[2]);
+}
+
+/**
+ * Apply the transposed linear part, normals are transformed by the transposed inverse.
+ */
+Vector Transform::applyTransposeToVector(const Vector& v) const {
+    return Vector(m[0][0]*v[0] + m[1][0]*v[1] + m[2][0]*v[2],
+                  m[0][1]*v[0] + m[1][1]*v[1] + m[2][1]*v[2],
+                  m[0][2]*v[0] + m[1][2]*v[1] + m[2][2]*v[2]);
+}
+
+/**
+ * @return bounds of the eight transformed corners of b
+ */
+BoundingBox Transform::applyToBox(const BoundingBox& b) const {
+    BoundingBox r;
+    if (b.isEmpty()) return r;
+    for (int corner = 0; corner < 8; corner++) {
+        Vector p(corner & 1 ? b.maxi[0] : b.mini[0],
+                 corner & 2 ? b.maxi[1] : b.mini[1],
+                 corner & 4 ? b.maxi[2] : b.mini[2]);
+        r.extend(applyToPoint(p));
+    }
+    return r;
+}
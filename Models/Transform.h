@@ -0,0 +1,35 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_TRANSFORM_H
+#define HELLOWORLD_TRANSFORM_H
+
+#include "Vector.h"
+#include "BoundingBox.h"
+
+/**
+ * Affine transform p -> M*p + T, stored as a 3x4 matrix.
+ */
+class Transform {
+public:
+    Transform();
+    Transform(const Vector& xAxis, const Vector& yAxis, const Vector& zAxis, const Vector& translation);
+    static Transform translation(const Vector& T);
+    static Transform scaling(const Vector& s);
+    static Transform rotation(const Vector& axis, double angle);
+
+    Transform operator*(const Transform& b) const;
+    Transform inverse() const;
+    Vector applyToPoint(const Vector& p) const;
+    Vector applyToPoint(const Vector& p, const Vector& pError, Vector& absError) const;
+    Vector applyToVector(const Vector& v) const;
+    Vector applyTransposeToVector(const Vector& v) const;
+    BoundingBox applyToBox(const BoundingBox& b) const;
+
+    // m[i][3] is the translation
+    double m[3][4];
+};
+
+
+#endif //HELLOWORLD_TRANSFORM_H
@@ -0,0 +1,28 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "TriangleBlock.h"
+
+/**
+ * Mark all lanes as unused, their degenerate triangles are never hit.
+ */
+void TriangleBlock::clear() {
+    for (int i = 0; i < TriangleBlockWidth; i++) {
+        for (int j = 0; j < 3; j++) {
+            v0[j][i] = 0;
+            e1[j][i] = 0;
+            e2[j][i] = 0;
+        }
+        triangle[i] = -1;
+    }
+}
+
+void TriangleBlock::setTriangle(int lane, const Vector& A, const Vector& B, const Vector& C, int triangle) {
+    for (int j = 0; j < 3; j++) {
+        v0[j][lane] = (float) A[j];
+        e1[j][lane] = (float) (B[j] - A[j]);
+        e2[j][lane] = (float) (C[j] - A[j]);
+    }
+    this->triangle[lane] = triangle;
+}
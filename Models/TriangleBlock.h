@@ -0,0 +1,134 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_TRIANGLEBLOCK_H
+#define HELLOWORLD_TRIANGLEBLOCK_H
+
+#include <cstdint>
+#include "Vector.h"
+#include "WideBVH.h"
+
+// number of triangles intersected by one SIMD kernel call
+#ifdef __AVX__
+static const int TriangleBlockWidth = 8;
+#else
+static const int TriangleBlockWidth = 4;
+#endif
+
+/**
+ * Pre-gathered triangles of a BVH leaf, stored as structure of arrays in single precision.
+ *
+ * Every lane holds the first vertex and the two edges of a triangle, so the intersection does not go
+ * through the index indirection and does not recompute the edges.
+ */
+class TriangleBlock {
+public:
+    void clear();
+    void setTriangle(int lane, const Vector& A, const Vector& B, const Vector& C, int triangle);
+
+    float v0[3][TriangleBlockWidth];
+    float e1[3][TriangleBlockWidth];
+    float e2[3][TriangleBlockWidth];
+    // index of the triangle in positionIndices, -1 for an unused lane
+    int32_t triangle[TriangleBlockWidth];
+};
+
+/**
+ * Moeller-Trumbore test of a ray against all triangles of a block.
+ *
+ * @param block triangles to test
+ * @param r incoming ray
+ * @param tMax closest hit so far, updated on a closer hit
+ * @return lane of the closest triangle hit before tMax, -1 if there is none
+ */
+inline int intersectBlock(const TriangleBlock& block, const WideRay& r, float& tMax) {
+    float t[TriangleBlockWidth];
+    int mask;
+#if defined(__AVX__)
+    __m256 dx = _mm256_set1_ps(r.u[0]), dy = _mm256_set1_ps(r.u[1]), dz = _mm256_set1_ps(r.u[2]);
+    __m256 e1x = _mm256_loadu_ps(block.e1[0]), e1y = _mm256_loadu_ps(block.e1[1]), e1z = _mm256_loadu_ps(block.e1[2]);
+    __m256 e2x = _mm256_loadu_ps(block.e2[0]), e2y = _mm256_loadu_ps(block.e2[1]), e2z = _mm256_loadu_ps(block.e2[2]);
+    // p = d x e2
+    __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+    __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.f), det);
+    // s = C - v0
+    __m256 sx = _mm256_sub_ps(_mm256_set1_ps(r.C[0]), _mm256_loadu_ps(block.v0[0]));
+    __m256 sy = _mm256_sub_ps(_mm256_set1_ps(r.C[1]), _mm256_loadu_ps(block.v0[1]));
+    __m256 sz = _mm256_sub_ps(_mm256_set1_ps(r.C[2]), _mm256_loadu_ps(block.v0[2]));
+    __m256 beta = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), invDet);
+    // q = s x e1
+    __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+    __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+    __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+    __m256 gamma = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), invDet);
+    __m256 tt = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 valid = _mm256_and_ps(_mm256_cmp_ps(beta, zero, _CMP_GE_OQ), _mm256_cmp_ps(gamma, zero, _CMP_GE_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(beta, gamma), _mm256_set1_ps(1.f), _CMP_LE_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(tt, zero, _CMP_GT_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(tt, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+    mask = _mm256_movemask_ps(valid);
+    if (!mask) return -1;
+    _mm256_storeu_ps(t, tt);
+#elif defined(HELLOWORLD_SSE)
+    __m128 dx = _mm_set1_ps(r.u[0]), dy = _mm_set1_ps(r.u[1]), dz = _mm_set1_ps(r.u[2]);
+    __m128 e1x = _mm_loadu_ps(block.e1[0]), e1y = _mm_loadu_ps(block.e1[1]), e1z = _mm_loadu_ps(block.e1[2]);
+    __m128 e2x = _mm_loadu_ps(block.e2[0]), e2y = _mm_loadu_ps(block.e2[1]), e2z = _mm_loadu_ps(block.e2[2]);
+    // p = d x e2
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+    // s = C - v0
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(r.C[0]), _mm_loadu_ps(block.v0[0]));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(r.C[1]), _mm_loadu_ps(block.v0[1]));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(r.C[2]), _mm_loadu_ps(block.v0[2]));
+    __m128 beta = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+    // q = s x e1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 gamma = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+    __m128 zero = _mm_setzero_ps();
+    __m128 valid = _mm_and_ps(_mm_cmpge_ps(beta, zero), _mm_cmpge_ps(gamma, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(beta, gamma), _mm_set1_ps(1.f)));
+    valid = _mm_and_ps(valid, _mm_cmpgt_ps(tt, zero));
+    valid = _mm_and_ps(valid, _mm_cmplt_ps(tt, _mm_set1_ps(tMax)));
+    mask = _mm_movemask_ps(valid);
+    if (!mask) return -1;
+    _mm_storeu_ps(t, tt);
+#else
+    mask = 0;
+    for (int i = 0; i < TriangleBlockWidth; i++) {
+        float px = r.u[1]*block.e2[2][i] - r.u[2]*block.e2[1][i];
+        float py = r.u[2]*block.e2[0][i] - r.u[0]*block.e2[2][i];
+        float pz = r.u[0]*block.e2[1][i] - r.u[1]*block.e2[0][i];
+        float invDet = 1.f / (block.e1[0][i]*px + block.e1[1][i]*py + block.e1[2][i]*pz);
+        float sx = r.C[0] - block.v0[0][i], sy = r.C[1] - block.v0[1][i], sz = r.C[2] - block.v0[2][i];
+        float beta = (sx*px + sy*py + sz*pz) * invDet;
+        float qx = sy*block.e1[2][i] - sz*block.e1[1][i];
+        float qy = sz*block.e1[0][i] - sx*block.e1[2][i];
+        float qz = sx*block.e1[1][i] - sy*block.e1[0][i];
+        float gamma = (r.u[0]*qx + r.u[1]*qy + r.u[2]*qz) * invDet;
+        t[i] = (block.e2[0][i]*qx + block.e2[1][i]*qy + block.e2[2][i]*qz) * invDet;
+        if (beta >= 0 && gamma >= 0 && beta + gamma <= 1 && t[i] > 0 && t[i] < tMax) mask |= 1 << i;
+    }
+    if (!mask) return -1;
+#endif
+    int lane = -1;
+    for (int i = 0; i < TriangleBlockWidth; i++) {
+        if ((mask & (1 << i)) && t[i] < tMax) {
+            tMax = t[i];
+            lane = i;
+        }
+    }
+    return lane;
+}
+
+#endif //HELLOWORLD_TRIANGLEBLOCK_H
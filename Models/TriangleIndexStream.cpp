@@ -0,0 +1,93 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "TriangleIndexStream.h"
+
+void TriangleIndexStream::clear() {
+    wide.clear();
+    narrow.clear();
+    isNarrow = false;
+}
+
+void TriangleIndexStream::reserve(size_t triangles) {
+    widen();
+    wide.reserve(3*triangles);
+}
+
+/**
+ * Change the number of triangles, new triangles have all indices missing.
+ */
+void TriangleIndexStream::resize(size_t triangles) {
+    widen();
+    wide.resize(3*triangles, -1);
+}
+
+void TriangleIndexStream::set(size_t triangle, int i, int j, int k) {
+    widen();
+    wide[3*triangle] = i;
+    wide[3*triangle + 1] = j;
+    wide[3*triangle + 2] = k;
+}
+
+void TriangleIndexStream::push_back(int i, int j, int k) {
+    widen();
+    wide.push_back(i);
+    wide.push_back(j);
+    wide.push_back(k);
+}
+
+/**
+ * Reorder the triangles, triangle n takes the indices of triangle order[n]. Triangles order leaves out are dropped.
+ */
+void TriangleIndexStream::permute(const std::vector<int>& order) {
+    if (isNarrow) {
+        std::vector<uint16_t> sorted(3*order.size());
+        for (size_t n = 0; n < order.size(); n++) {
+            for (int c = 0; c < 3; c++) sorted[3*n + c] = narrow[3*order[n] + c];
+        }
+        narrow.swap(sorted);
+    } else {
+        std::vector<int32_t> sorted(3*order.size());
+        for (size_t n = 0; n < order.size(); n++) {
+            for (int c = 0; c < 3; c++) sorted[3*n + c] = wide[3*order[n] + c];
+        }
+        wide.swap(sorted);
+    }
+}
+
+/**
+ * Switch to 16-bit indices if every index fits.
+ */
+void TriangleIndexStream::compact() {
+    if (isNarrow) return;
+    for (size_t n = 0; n < wide.size(); n++) {
+        if (wide[n] > MaxNarrowIndex) return;
+    }
+    narrow.resize(wide.size());
+    for (size_t n = 0; n < wide.size(); n++) {
+        narrow[n] = wide[n] < 0 ? MaxNarrowIndex + 1 : wide[n];
+    }
+    std::vector<int32_t>().swap(wide);
+    isNarrow = true;
+}
+
+/**
+ * Switch back to 32-bit indices, e.g. before more triangles are added.
+ */
+void TriangleIndexStream::widen() {
+    if (!isNarrow) return;
+    wide.resize(narrow.size());
+    for (size_t n = 0; n < narrow.size(); n++) {
+        wide[n] = narrow[n] > MaxNarrowIndex ? -1 : narrow[n];
+    }
+    std::vector<uint16_t>().swap(narrow);
+    isNarrow = false;
+}
+
+/**
+ * @return bytes used by the indices
+ */
+size_t TriangleIndexStream::memoryUsage() const {
+    return isNarrow ? narrow.size() * sizeof(uint16_t) : wide.size() * sizeof(int32_t);
+}
@@ -0,0 +1,61 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_TRIANGLEINDEXSTREAM_H
+#define HELLOWORLD_TRIANGLEINDEXSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// largest index a narrow stream can hold, the next value encodes a missing index
+static const int MaxNarrowIndex = 0xFFFE;
+
+/**
+ * Three indices per triangle into one attribute array (positions, uvs or normals), stored contiguously.
+ *
+ * A stream holds 32-bit indices while it is being filled. compact switches it to 16-bit indices if all
+ * of them fit, which halves it for meshes with up to 65535 entries in the attribute array. A missing
+ * index is stored as -1.
+ */
+class TriangleIndexStream {
+public:
+    TriangleIndexStream() : isNarrow(false) {}
+    size_t size() const { return (isNarrow ? narrow.size() : wide.size()) / 3; }
+    bool empty() const { return size() == 0; }
+    void clear();
+    void reserve(size_t triangles);
+    void resize(size_t triangles);
+    void set(size_t triangle, int i, int j, int k);
+    void push_back(int i, int j, int k);
+    void get(size_t triangle, int& i, int& j, int& k) const;
+    void permute(const std::vector<int>& order);
+    void compact();
+    void widen();
+    size_t memoryUsage() const;
+
+    // true if the indices are stored in narrow, false if in wide
+    bool isNarrow;
+    std::vector<int32_t> wide;
+    std::vector<uint16_t> narrow;
+};
+
+/**
+ * Read the indices of a triangle, kept inline as it runs for every hit.
+ */
+inline void TriangleIndexStream::get(size_t triangle, int& i, int& j, int& k) const {
+    if (isNarrow) {
+        const uint16_t* p = &narrow[3*triangle];
+        i = p[0] > MaxNarrowIndex ? -1 : p[0];
+        j = p[1] > MaxNarrowIndex ? -1 : p[1];
+        k = p[2] > MaxNarrowIndex ? -1 : p[2];
+    } else {
+        const int32_t* p = &wide[3*triangle];
+        i = p[0];
+        j = p[1];
+        k = p[2];
+    }
+}
+
+#endif //HELLOWORLD_TRIANGLEINDEXSTREAM_H
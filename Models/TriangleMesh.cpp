@@ -3,13 +3,19 @@
 //
 
 #include "TriangleMesh.h"
-#include <list>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "Parallel.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "ObjParsing.h"
 
-TriangleMesh::TriangleMesh(const Vector& albedo, bool mirror = false, bool transparent = false) {
+TriangleMesh::TriangleMesh(const Vector& albedo, bool mirror, bool transparent) {
     this->albedo = albedo;
     isMirror = mirror;
     isTransparent = transparent;
-    BVH = new Node;
+    type = MeshObject;
 };
 
 BoundingBox TriangleMesh::buildBB(int beginning, int end) {
@@ -17,271 +23,520 @@ BoundingBox TriangleMesh::buildBB(int beginning, int end) {
     bb.mini = Vector(1E9, 1E9, 1E9);
     bb.maxi = Vector(-1E9, -1E9, -1E9);
     for (int i = beginning; i < end; i++) {
-        for (int j = 0; j < 3; j++) {
-            bb.mini[j] = std::min(bb.mini[j], vertices[indices[i].vtxi][j]);
-            bb.maxi[j] = std::max(bb.maxi[j], vertices[indices[i].vtxi][j]);
-            bb.mini[j] = std::min(bb.mini[j], vertices[indices[i].vtxj][j]);
-            bb.maxi[j] = std::max(bb.maxi[j], vertices[indices[i].vtxj][j]);
-            bb.mini[j] = std::min(bb.mini[j], vertices[indices[i].vtxk][j]);
-            bb.maxi[j] = std::max(bb.maxi[j], vertices[indices[i].vtxk][j]);
+        int vertex[3];
+        positionIndices.get(i, vertex[0], vertex[1], vertex[2]);
+        for (int c = 0; c < 3; c++) {
+            for (int j = 0; j < 3; j++) {
+                bb.mini[j] = std::min(bb.mini[j], vertices[vertex[c]][j]);
+                bb.maxi[j] = std::max(bb.maxi[j], vertices[vertex[c]][j]);
+            }
         }
     }
     return bb;
 }
 
-void TriangleMesh::buildBVH(Node* n, int beginning, int end) {
-    n->b = buildBB(n->beginning, n->end);
-    n->beginning = beginning;
-    n->end = end;
-    Vector diag = n->b.maxi - n->b.mini;
-    int dim;
-    if (diag[0] >= diag[1] && diag[0] >= diag[2]) {
-        dim = 0;
-    } else {
-        if (diag[1] >= diag[0] && diag[1] >= diag[2]) {
-            dim = 1;
-        } else {
-            dim = 2;
+/**
+ * Build the BVH of the mesh with bvhSettings and flatten it into nodes.
+ *
+ * The triangles are reordered so that every leaf references a contiguous range, which is then
+ * packed into triangle blocks, and their index streams are compacted. bvhStatistics reports the time of the whole build, including the preparation of the triangle bounds.
+ */
+void TriangleMesh::buildBVH() {
+    auto start = std::chrono::steady_clock::now();
+    int numberOfThreads = resolveThreadCount(bvhSettings.numberOfThreads);
+
+    std::vector<BoundingBox> triangleBounds(triangleCount());
+    std::vector<Vector> centroids(triangleCount());
+    parallelFor(0, triangleCount(), numberOfThreads, [&](int beginning, int end, int) {
+        for (int i = beginning; i < end; i++) {
+            int a, b, c;
+            positionIndices.get(i, a, b, c);
+            const Vector &A = vertices[a];
+            const Vector &B = vertices[b];
+            const Vector &C = vertices[c];
+            triangleBounds[i].extend(A);
+            triangleBounds[i].extend(B);
+            triangleBounds[i].extend(C);
+            centroids[i] = (A + B + C)/3.0;
         }
+    });
+
+    std::vector<int> order;
+    BVHBuilder builder(bvhSettings, triangleBounds, centroids);
+    builder.build(nodes, order, bvhStatistics);
+
+    permuteTriangles(order);
+    compactIndices();
+    bb = buildBB(0, triangleCount());
+    packTriangleBlocks();
+
+    nodes4.clear();
+    nodes8.clear();
+    if (bvhSettings.width == 4) {
+        collapseBVH<4>(nodes, nodes4);
+    } else if (bvhSettings.width == 8) {
+        collapseBVH<8>(nodes, nodes8);
+    }
+
+    bvhStatistics.buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (bvhStatistics.buildTime > 0) {
+        bvhStatistics.primitivesPerSecond = triangleCount() / bvhStatistics.buildTime;
     }
-    double middle = (n->b.mini[dim] + n->b.maxi[dim])*0.5;
-    int indicePivot = n->beginning;
-    for (int i = n->beginning; i < n->end; i++) {
-        double middleTriangle = (vertices[indices[i].vtxi][dim] + vertices[indices[i].vtxj][dim] + vertices[indices[i].vtxk][dim])/3.0;
-        if (middleTriangle < middle) {
-            std::swap(indices[i], indices[indicePivot]);
-            indicePivot++;
+}
+
+/**
+ * Reorder the triangles in every index stream, triangle n takes the indices of triangle order[n].
+ *
+ * @param order new order of the triangles, triangles it leaves out are dropped
+ */
+void TriangleMesh::permuteTriangles(const std::vector<int>& order) {
+    positionIndices.permute(order);
+    if (!uvIndices.empty()) uvIndices.permute(order);
+    if (!normalIndices.empty()) normalIndices.permute(order);
+    if (!groups.empty()) {
+        std::vector<int32_t> sortedGroups(order.size());
+        for (int i = 0; i < order.size(); i++) {
+            sortedGroups[i] = groups[order[i]];
         }
+        groups.swap(sortedGroups);
     }
-    n->fg = NULL;
-    n->fd = NULL;
-    if (indicePivot == beginning || indicePivot == end || (end - beginning < 5)) {
-        return;
+}
+
+/**
+ * Store the index streams with 16 bits per index where possible and drop the cold streams in which every
+ * index is missing.
+ */
+void TriangleMesh::compactIndices() {
+    positionIndices.compact();
+    TriangleIndexStream* coldStreams[] = {&uvIndices, &normalIndices};
+    for (TriangleIndexStream* stream : coldStreams) {
+        bool anyIndex = false;
+        for (size_t i = 0; i < stream->size() && !anyIndex; i++) {
+            int a, b, c;
+            stream->get(i, a, b, c);
+            anyIndex = a >= 0 || b >= 0 || c >= 0;
+        }
+        if (anyIndex) {
+            stream->compact();
+        } else {
+            stream->clear();
+        }
     }
-    n->fg = new Node;
-    n->fd = new Node;
+    if (std::find_if(groups.begin(), groups.end(), [](int32_t g) { return g >= 0; }) == groups.end()) {
+        groups.clear();
+    }
+}
 
-    buildBVH(n->fg, n->beginning, indicePivot);
-    buildBVH(n->fd, indicePivot, n->end);
+/**
+ * @return bytes used by the index streams and the groups
+ */
+size_t TriangleMesh::indexMemory() const {
+    return positionIndices.memoryUsage() + uvIndices.memoryUsage() + normalIndices.memoryUsage()
+           + groups.size() * sizeof(int32_t);
 }
 
-bool TriangleMesh::intersect(const Ray& r, Vector& P, Vector& normal, double &t) {
-    if (!BVH->b.intersect(r)) return false;
+/**
+ * Copy the triangles of every leaf into blocks and let the leaves reference their blocks.
+ */
+void TriangleMesh::packTriangleBlocks() {
+    blocks.clear();
+    for (int n = 0; n < nodes.size(); n++) {
+        if (!nodes[n].isLeaf()) continue;
+        int beginning = nodes[n].offset;
+        int end = beginning + nodes[n].count;
+        int firstBlock = blocks.size();
+        for (int i = beginning; i < end; i += TriangleBlockWidth) {
+            TriangleBlock block;
+            block.clear();
+            for (int lane = 0; lane < TriangleBlockWidth && i + lane < end; lane++) {
+                int a, b, c;
+                positionIndices.get(i + lane, a, b, c);
+                block.setTriangle(lane, vertices[a], vertices[b], vertices[c], i + lane);
+            }
+            blocks.push_back(block);
+        }
+        nodes[n].offset = firstBlock;
+        nodes[n].count = blocks.size() - firstBlock;
+    }
+}
+
+/**
+ * Check if a given ray intersects the mesh.
+ *
+ * Nodes which the ray enters beyond the closest intersection found so far are skipped. The leaves are tested a whole triangle block at a time, only the closest triangle is then
+ * intersected again in double precision to get P and the normal.
+ *
+ * @param r incoming ray
+ * @param P intersection point
+ * @param normal normal vector of the triangle at the intersection point
+ * @param pError bound on the absolute error of P
+ * @param t distance of the closest intersection
+ * @return true if the ray intersects a triangle of the mesh
+ */
+bool TriangleMesh::intersect(const Ray& r, Vector& P, Vector& normal, Vector& pError, double &t) {
+    if (nodes.empty()) return false;
     t = 1E9;
-    bool hasInter = false;
-    std::list<Node*> l;
-    l.push_back(BVH);
-    while (!l.empty()) {
-        Node* c = l.front();
-        l.pop_front();
-        if (c->fg) {
-            if (c->fg->b.intersect(r)) {
-                l.push_front(c->fg);
+    WideRay wr(r);
+    float tBlock = 1E9;
+    int hitTriangle = -1;
+
+    traverse(r, t, [&](int first, int count) {
+        for (int b = first; b < first + count; b++) {
+            int lane = intersectBlock(blocks[b], wr, tBlock);
+            if (lane >= 0) {
+                hitTriangle = blocks[b].triangle[lane];
+                t = tBlock;
             }
-            if (c->fd->b.intersect(r)) {
-                l.push_front(c->fd);
+        }
+        return false;
+    });
+
+    if (hitTriangle < 0) return false;
+    computeHit(r, hitTriangle, P, normal, pError, t);
+    return true;
+}
+
+/**
+ * Check if any triangle of the mesh lies on the ray segment (0, tMax).
+ *
+ * The traversal stops at the first triangle found and no surface data is computed.
+ *
+ * @param r incoming ray
+ * @param tMax end of the segment
+ * @return true if the segment is blocked by the mesh
+ */
+bool TriangleMesh::occluded(const Ray& r, double tMax) {
+    if (nodes.empty()) return false;
+    WideRay wr(r);
+    bool blocked = false;
+
+    traverse(r, tMax, [&](int first, int count) {
+        for (int b = first; b < first + count; b++) {
+            float tBlock = tMax;
+            if (intersectBlock(blocks[b], wr, tBlock) >= 0) {
+                blocked = true;
+                return true;
             }
-        } else {
-            for (int i = c->beginning; i <c->end; i++) {
-                const Vector &A = vertices[indices[i].vtxi];
-                const Vector &B = vertices[indices[i].vtxj];
-                const Vector &C = vertices[indices[i].vtxk];
-
-                Vector e1 = B - A;
-                Vector e2 = C - A;
-                Vector N = cross(e1, e2);
-                Vector AO = r.C - A;
-                Vector AOu = cross(AO, r.u);
-                double invUN = 1./dot(r.u, N);
-                double beta = - dot(e2, AOu)*invUN;
-                double gamma = dot(e1, AOu)*invUN;
-                double alpha = 1 - beta - gamma;
-                double localt = - dot(AO, N)*invUN;
-                if (beta >= 0 && gamma >= 0 && beta <= 1 && gamma <= 1 && alpha >= 0 && localt > 0) {
-                    hasInter = true;
-                    if (localt < t) {
-                        t = localt;
-                        normal = N.getNormalized();
-                        P = r.C + t * r.u;
-                    }
-                }
+        }
+        return false;
+    });
+
+    return blocked;
+}
+
+/**
+ * Intersect a coherent packet of rays with the mesh.
+ *
+ * The packet walks the binary BVH together, nodes outside its frustum are culled for all rays at once.
+ * Leaves are tested one active lane at a time with the block kernel. Incoherent packets fall back to
+ * one traversal per ray.
+ *
+ * @param packet rays to intersect
+ * @param mask lanes to test
+ * @param t closest hit of every lane so far, updated on a closer hit
+ * @param P intersection point of every lane
+ * @param normal normal vector at the intersection point of every lane
+ * @param pError bound on the absolute error of P of every lane
+ * @return bit mask of the lanes with a closer hit
+ */
+int TriangleMesh::intersectPacket(const RayPacket& packet, int mask, double* t, Vector* P, Vector* normal, Vector* pError) {
+    if (!packet.coherent) return Object::intersectPacket(packet, mask, t, P, normal, pError);
+    float tBlock[RayPacketSize];
+    int hitTriangle[RayPacketSize];
+    for (int lane = 0; lane < RayPacketSize; lane++) {
+        tBlock[lane] = (float) std::min(1E9, t[lane < packet.count ? lane : 0]);
+        hitTriangle[lane] = -1;
+    }
+
+    traversePacketBVH(nodes, packet, tBlock, mask, [&](int first, int count, int lanes) {
+        for (int lane = 0; lane < packet.count; lane++) {
+            if (!(lanes & (1 << lane))) continue;
+            for (int b = first; b < first + count; b++) {
+                int hit = intersectBlock(blocks[b], packet.lanes[lane], tBlock[lane]);
+                if (hit >= 0) hitTriangle[lane] = blocks[b].triangle[hit];
             }
         }
+    });
+
+    int hits = 0;
+    for (int lane = 0; lane < packet.count; lane++) {
+        if (hitTriangle[lane] < 0) continue;
+        Ray r(packet.origins[lane], packet.directions[lane]);
+        Vector localP, localN, localError;
+        double localt = tBlock[lane];
+        computeHit(r, hitTriangle[lane], localP, localN, localError, localt);
+        if (localt < t[lane]) {
+            t[lane] = localt;
+            P[lane] = localP;
+            normal[lane] = localN;
+            pError[lane] = localError;
+            hits |= 1 << lane;
+        }
     }
+    return hits;
+}
 
-    return hasInter;
+/**
+ * Visit the BVH leaves hit by a ray front to back, in the binary or the wide BVH.
+ *
+ * @param r incoming ray
+ * @param tMax end of the ray segment, may be shortened by leaf
+ * @param leaf called as leaf(firstBlock, numberOfBlocks), returns true to stop the traversal
+ */
+template<typename Leaf>
+void TriangleMesh::traverse(const Ray& r, double& tMax, Leaf leaf) {
+    if (!nodes8.empty()) {
+        traverseWideBVH<8>(nodes8, r, tMax, leaf);
+    } else if (!nodes4.empty()) {
+        traverseWideBVH<4>(nodes4, r, tMax, leaf);
+    } else {
+        traverseBVH(nodes, r, tMax, leaf);
+    }
+}
+
+/**
+ * @return bounds of the mesh as of the last buildBVH
+ */
+BoundingBox TriangleMesh::bounds() {
+    return bb;
+}
+
+/**
+ * Intersect a ray with a single triangle in the precision of Scalar, the normal is normalised only here.
+ *
+ * P is interpolated from the vertices with the barycentric coordinates of the hit, so its error is bounded
+ * by the magnitude of the vertices and not by the distance along the ray. The bound is taken in single
+ * precision even for a double Scalar, since rays leaving P are tested again by the single precision blocks.
+ * If the test in Scalar misses the triangle, the barycentric coordinates are meaningless, so P is then taken
+ * along the ray at the distance found by the blocks and its bound grows with that distance.
+ *
+ * @param r incoming ray
+ * @param triangle index of the triangle in positionIndices
+ * @param P intersection point
+ * @param normal normal vector of the triangle
+ * @param pError bound on the absolute error of P
+ * @param t distance of the intersection, kept if the test in Scalar misses the triangle
+ */
+void TriangleMesh::computeHit(const Ray& r, int triangle, Vector& P, Vector& normal, Vector& pError, double &t) {
+    int a, b, c;
+    positionIndices.get(triangle, a, b, c);
+    const Vector &A = vertices[a];
+    const Vector &B = vertices[b];
+    const Vector &C = vertices[c];
+
+    Vector e1 = B - A;
+    Vector e2 = C - A;
+    Vector AO = r.C - A;
+    Vector p = cross(r.u, e2);
+    Vector q = cross(AO, e1);
+    Scalar invDet = 1 / dot(e1, p);
+    Scalar beta = dot(AO, p) * invDet;
+    Scalar gamma = dot(r.u, q) * invDet;
+    Scalar localt = dot(e2, q) * invDet;
+    normal = cross(e1, e2).getNormalizedFast();
+    if (localt <= 0) {
+        P = r.C + t * r.u;
+        pError = gammaBound<float>(7) * (absolute(r.C) + absolute(t * r.u));
+        return;
+    }
+    t = localt;
+    Scalar alpha = 1 - beta - gamma;
+    P = alpha*A + beta*B + gamma*C;
+    pError = gammaBound<float>(7) * (absolute(alpha*A) + absolute(beta*B) + absolute(gamma*C));
 }
 
-void TriangleMesh::readOBJ(const char* obj) {
+/**
+ * Read a Wavefront OBJ file and append its vertices, normals, uvs and triangles to the mesh.
+ *
+ * The file is memory-mapped and tokenized in place, so lines can have any length. It is split at line
+ * boundaries into one part per thread. A first parallel pass counts the lines of every kind in each part,
+ * a prefix sum over these counts gives every part the index of its first vertex, normal, uv and group,
+ * and the parts are then parsed in parallel, straight into the arrays. The triangles and vertex colors of
+ * the parts are concatenated last, so the result is the same for any number of threads.
+ *
+ * Polygons are split into triangle fans, negative indices count back from the last element read so far.
+ * Every usemtl line starts a new group.
+ *
+ * @param obj path of the file
+ * @param numberOfThreads threads used for parsing, 0 means one per hardware thread
+ * @return false if the file could not be opened
+ */
+bool TriangleMesh::readOBJ(const char* obj, int numberOfThreads) {
+    MappedFile file;
+    if (!file.open(obj)) return false;
+    const char* data = file.data();
+    const char* end = data + file.size();
 
-    char matfile[255];
-    char grp[255];
+    // parts smaller than this are not worth a thread
+    const size_t minPartSize = 1 << 20;
+    int parts = (int) std::max<size_t>(1, std::min<size_t>(resolveThreadCount(numberOfThreads), file.size() / minPartSize));
+    std::vector<const char*> partBegin(parts + 1);
+    partBegin[0] = data;
+    partBegin[parts] = end;
+    for (int k = 1; k < parts; k++) {
+        const char* p = data + file.size() * k / parts;
+        partBegin[k] = std::max(partBegin[k - 1], p[-1] == '\n' ? p : nextLine(p, end));
+    }
 
-    FILE* f;
-    f = fopen(obj, "r");
-    int curGroup = -1;
-    while (!feof(f)) {
-        char line[255];
-        if (!fgets(line, 255, f)) break;
+    std::vector<ObjCounts> first(parts + 1);
+    parallelFor(0, parts, parts, [&](int beginning, int, int) {
+        first[beginning + 1] = countObjLines(partBegin[beginning], partBegin[beginning + 1]);
+    }, 1);
+    first[0].vertices = vertices.size();
+    first[0].normals = normals.size();
+    first[0].uvs = uvs.size();
+    first[0].groups = -1;
+    for (int k = 1; k <= parts; k++) {
+        first[k].vertices += first[k - 1].vertices;
+        first[k].normals += first[k - 1].normals;
+        first[k].uvs += first[k - 1].uvs;
+        first[k].faces += first[k - 1].faces;
+        first[k].groups += first[k - 1].groups;
+    }
+    vertices.resize(first[parts].vertices);
+    normals.resize(first[parts].normals);
+    uvs.resize(first[parts].uvs);
 
-        std::string linetrim(line);
-        linetrim.erase(linetrim.find_last_not_of(" \r\t") + 1);
-        strcpy(line, linetrim.c_str());
+    std::vector<std::vector<TriangleIndices> > partTriangles(parts);
+    std::vector<std::vector<Vector> > partColors(parts);
+    parallelFor(0, parts, parts, [&](int beginning, int, int) {
+        partTriangles[beginning].reserve(first[beginning + 1].faces - first[beginning].faces);
+        parseOBJ(partBegin[beginning], partBegin[beginning + 1], first[beginning], partTriangles[beginning], partColors[beginning]);
+    }, 1);
 
-        if (line[0] == 'u' && line[1] == 's') {
-            sscanf(line, "usemtl %[^\n]\n", grp);
-            curGroup++;
+    // the triangles are split into the index streams, cold streams dropped by an earlier build are refilled
+    std::vector<size_t> firstTriangle(parts + 1, triangleCount());
+    for (int k = 0; k < parts; k++) {
+        firstTriangle[k + 1] = firstTriangle[k] + partTriangles[k].size();
+    }
+    positionIndices.resize(firstTriangle[parts]);
+    uvIndices.resize(firstTriangle[parts]);
+    normalIndices.resize(firstTriangle[parts]);
+    groups.resize(firstTriangle[parts], -1);
+    parallelFor(0, parts, parts, [&](int beginning, int, int) {
+        for (size_t i = 0; i < partTriangles[beginning].size(); i++) {
+            const TriangleIndices& t = partTriangles[beginning][i];
+            size_t triangle = firstTriangle[beginning] + i;
+            positionIndices.set(triangle, t.vtxi, t.vtxj, t.vtxk);
+            uvIndices.set(triangle, t.uvi, t.uvj, t.uvk);
+            normalIndices.set(triangle, t.ni, t.nj, t.nk);
+            groups[triangle] = t.group;
         }
+    }, 1);
+    for (int k = 0; k < parts; k++) {
+        vertexcolors.insert(vertexcolors.end(), partColors[k].begin(), partColors[k].end());
+    }
+    return true;
+}
 
-        if (line[0] == 'v' && line[1] == ' ') {
-            Vector vec;
+/**
+ * Load a mesh from an OBJ file and build its BVH, or read both from a cache written by an earlier call.
+ *
+ * The cache is used if it was written for the same file content, optimizerSettings and bvhSettings.
+ * Otherwise the file is parsed, optimized by MeshOptimizer, the BVH is built and the cache is rewritten.
+ * The mesh is cleared first.
+ *
+ * @param obj path of the OBJ file
+ * @param cache path of the cache file
+ * @param numberOfThreads threads used for hashing and parsing, 0 means one per hardware thread
+ * @return false if the OBJ file could not be read
+ */
+bool TriangleMesh::loadOBJ(const char* obj, const char* cache, int numberOfThreads) {
+    uint64_t key;
+    {
+        MappedFile file;
+        if (!file.open(obj)) return false;
+        key = MeshCache::key(file.data(), file.size(), optimizerSettings, bvhSettings, numberOfThreads);
+    }
+    if (MeshCache::load(*this, cache, key)) return true;
 
-            Vector col;
-            if (sscanf(line, "v %lf %lf %lf %lf %lf %lf\n", &vec[0], &vec[1], &vec[2], &col[0], &col[1], &col[2]) == 6) {
-                col[0] = std::min(1., std::max(0., col[0]));
-                col[1] = std::min(1., std::max(0., col[1]));
-                col[2] = std::min(1., std::max(0., col[2]));
+    positionIndices.clear();
+    uvIndices.clear();
+    normalIndices.clear();
+    groups.clear();
+    vertices.clear();
+    normals.clear();
+    uvs.clear();
+    vertexcolors.clear();
+    if (!readOBJ(obj, numberOfThreads)) return false;
+    MeshOptimizer::optimize(*this, optimizerSettings, optimizerStatistics, numberOfThreads);
+    buildBVH();
+    MeshCache::save(*this, cache, key);
+    return true;
+}
 
-                vertices.push_back(vec);
-                vertexcolors.push_back(col);
+/**
+ * Parse a part of an OBJ file, writing its vertices, normals and uvs at the positions given by first.
+ *
+ * @param begin start of the part, the beginning of a line
+ * @param end end of the part, the beginning of a line or the end of the file
+ * @param first indices of the first vertex, normal and uv of the part and the group before its first usemtl
+ * @param triangles receives the triangles of the part
+ * @param colors receives the vertex colors of the part
+ */
+void TriangleMesh::parseOBJ(const char* begin, const char* end, const ObjCounts& first,
+                            std::vector<TriangleIndices>& triangles, std::vector<Vector>& colors) {
+    size_t vertexCount = first.vertices, normalCount = first.normals, uvCount = first.uvs;
+    int curGroup = first.groups;
+    for (const char* line = begin; line < end; ) {
+        const char* next = nextLine(line, end);
+        const char* eol = next > line && next[-1] == '\n' ? next - 1 : next;
+        const char* p = skipBlanks(line, eol);
+        line = next;
 
-            } else {
-                sscanf(line, "v %lf %lf %lf\n", &vec[0], &vec[1], &vec[2]);
-                vertices.push_back(vec);
-            }
-        }
-        if (line[0] == 'v' && line[1] == 'n') {
-            Vector vec;
-            sscanf(line, "vn %lf %lf %lf\n", &vec[0], &vec[1], &vec[2]);
-            normals.push_back(vec);
-        }
-        if (line[0] == 'v' && line[1] == 't') {
-            Vector vec;
-            sscanf(line, "vt %lf %lf\n", &vec[0], &vec[1]);
-            uvs.push_back(vec);
-        }
-        if (line[0] == 'f') {
-            TriangleIndices t;
-            int i0, i1, i2, i3;
-            int j0, j1, j2, j3;
-            int k0, k1, k2, k3;
-            int nn;
-            t.group = curGroup;
-
-            char* consumedline = line + 1;
-            int offset;
-
-            nn = sscanf(consumedline, "%u/%u/%u %u/%u/%u %u/%u/%u%n", &i0, &j0, &k0, &i1, &j1, &k1, &i2, &j2, &k2, &offset);
-            if (nn == 9) {
-                if (i0 < 0) t.vtxi = vertices.size() + i0; else t.vtxi = i0 - 1;
-                if (i1 < 0) t.vtxj = vertices.size() + i1; else t.vtxj = i1 - 1;
-                if (i2 < 0) t.vtxk = vertices.size() + i2; else t.vtxk = i2 - 1;
-                if (j0 < 0) t.uvi = uvs.size() + j0; else   t.uvi = j0 - 1;
-                if (j1 < 0) t.uvj = uvs.size() + j1; else   t.uvj = j1 - 1;
-                if (j2 < 0) t.uvk = uvs.size() + j2; else   t.uvk = j2 - 1;
-                if (k0 < 0) t.ni = normals.size() + k0; else    t.ni = k0 - 1;
-                if (k1 < 0) t.nj = normals.size() + k1; else    t.nj = k1 - 1;
-                if (k2 < 0) t.nk = normals.size() + k2; else    t.nk = k2 - 1;
-                indices.push_back(t);
-            } else {
-                nn = sscanf(consumedline, "%u/%u %u/%u %u/%u%n", &i0, &j0, &i1, &j1, &i2, &j2, &offset);
-                if (nn == 6) {
-                    if (i0 < 0) t.vtxi = vertices.size() + i0; else t.vtxi = i0 - 1;
-                    if (i1 < 0) t.vtxj = vertices.size() + i1; else t.vtxj = i1 - 1;
-                    if (i2 < 0) t.vtxk = vertices.size() + i2; else t.vtxk = i2 - 1;
-                    if (j0 < 0) t.uvi = uvs.size() + j0; else   t.uvi = j0 - 1;
-                    if (j1 < 0) t.uvj = uvs.size() + j1; else   t.uvj = j1 - 1;
-                    if (j2 < 0) t.uvk = uvs.size() + j2; else   t.uvk = j2 - 1;
-                    indices.push_back(t);
-                } else {
-                    nn = sscanf(consumedline, "%u %u %u%n", &i0, &i1, &i2, &offset);
-                    if (nn == 3) {
-                        if (i0 < 0) t.vtxi = vertices.size() + i0; else t.vtxi = i0 - 1;
-                        if (i1 < 0) t.vtxj = vertices.size() + i1; else t.vtxj = i1 - 1;
-                        if (i2 < 0) t.vtxk = vertices.size() + i2; else t.vtxk = i2 - 1;
-                        indices.push_back(t);
-                    } else {
-                        nn = sscanf(consumedline, "%u//%u %u//%u %u//%u%n", &i0, &k0, &i1, &k1, &i2, &k2, &offset);
-                        if (i0 < 0) t.vtxi = vertices.size() + i0; else t.vtxi = i0 - 1;
-                        if (i1 < 0) t.vtxj = vertices.size() + i1; else t.vtxj = i1 - 1;
-                        if (i2 < 0) t.vtxk = vertices.size() + i2; else t.vtxk = i2 - 1;
-                        if (k0 < 0) t.ni = normals.size() + k0; else    t.ni = k0 - 1;
-                        if (k1 < 0) t.nj = normals.size() + k1; else    t.nj = k1 - 1;
-                        if (k2 < 0) t.nk = normals.size() + k2; else    t.nk = k2 - 1;
-                        indices.push_back(t);
-                    }
+        switch (objLineType(p, eol)) {
+            case ObjVertex: {
+                // coordinates are parsed in double, whatever Scalar is, an optional color follows them
+                double c[6] = {0, 0, 0, 0, 0, 0};
+                p += 1;
+                int n = 0;
+                while (n < 6 && parseDouble(p, eol, c[n])) n++;
+                vertices[vertexCount++] = Vector(c[0], c[1], c[2]);
+                if (n == 6) {
+                    colors.push_back(Vector(std::min(1., std::max(0., c[3])),
+                                            std::min(1., std::max(0., c[4])),
+                                            std::min(1., std::max(0., c[5]))));
                 }
+                break;
             }
-
-            consumedline = consumedline + offset;
-
-            while (true) {
-                if (consumedline[0] == '\n') break;
-                if (consumedline[0] == '\0') break;
-                nn = sscanf(consumedline, "%u/%u/%u%n", &i3, &j3, &k3, &offset);
-                TriangleIndices t2;
-                t2.group = curGroup;
-                if (nn == 3) {
-                    if (i0 < 0) t2.vtxi = vertices.size() + i0; else    t2.vtxi = i0 - 1;
-                    if (i2 < 0) t2.vtxj = vertices.size() + i2; else    t2.vtxj = i2 - 1;
-                    if (i3 < 0) t2.vtxk = vertices.size() + i3; else    t2.vtxk = i3 - 1;
-                    if (j0 < 0) t2.uvi = uvs.size() + j0; else  t2.uvi = j0 - 1;
-                    if (j2 < 0) t2.uvj = uvs.size() + j2; else  t2.uvj = j2 - 1;
-                    if (j3 < 0) t2.uvk = uvs.size() + j3; else  t2.uvk = j3 - 1;
-                    if (k0 < 0) t2.ni = normals.size() + k0; else   t2.ni = k0 - 1;
-                    if (k2 < 0) t2.nj = normals.size() + k2; else   t2.nj = k2 - 1;
-                    if (k3 < 0) t2.nk = normals.size() + k3; else   t2.nk = k3 - 1;
-                    indices.push_back(t2);
-                    consumedline = consumedline + offset;
-                    i2 = i3;
-                    j2 = j3;
-                    k2 = k3;
-                } else {
-                    nn = sscanf(consumedline, "%u/%u%n", &i3, &j3, &offset);
-                    if (nn == 2) {
-                        if (i0 < 0) t2.vtxi = vertices.size() + i0; else    t2.vtxi = i0 - 1;
-                        if (i2 < 0) t2.vtxj = vertices.size() + i2; else    t2.vtxj = i2 - 1;
-                        if (i3 < 0) t2.vtxk = vertices.size() + i3; else    t2.vtxk = i3 - 1;
-                        if (j0 < 0) t2.uvi = uvs.size() + j0; else  t2.uvi = j0 - 1;
-                        if (j2 < 0) t2.uvj = uvs.size() + j2; else  t2.uvj = j2 - 1;
-                        if (j3 < 0) t2.uvk = uvs.size() + j3; else  t2.uvk = j3 - 1;
-                        consumedline = consumedline + offset;
-                        i2 = i3;
-                        j2 = j3;
-                        indices.push_back(t2);
-                    } else {
-                        nn = sscanf(consumedline, "%u//%u%n", &i3, &k3, &offset);
-                        if (nn == 2) {
-                            if (i0 < 0) t2.vtxi = vertices.size() + i0; else    t2.vtxi = i0 - 1;
-                            if (i2 < 0) t2.vtxj = vertices.size() + i2; else    t2.vtxj = i2 - 1;
-                            if (i3 < 0) t2.vtxk = vertices.size() + i3; else    t2.vtxk = i3 - 1;
-                            if (k0 < 0) t2.ni = normals.size() + k0; else   t2.ni = k0 - 1;
-                            if (k2 < 0) t2.nj = normals.size() + k2; else   t2.nj = k2 - 1;
-                            if (k3 < 0) t2.nk = normals.size() + k3; else   t2.nk = k3 - 1;
-                            consumedline = consumedline + offset;
-                            i2 = i3;
-                            k2 = k3;
-                            indices.push_back(t2);
-                        } else {
-                            nn = sscanf(consumedline, "%u%n", &i3, &offset);
-                            if (nn == 1) {
-                                if (i0 < 0) t2.vtxi = vertices.size() + i0; else    t2.vtxi = i0 - 1;
-                                if (i2 < 0) t2.vtxj = vertices.size() + i2; else    t2.vtxj = i2 - 1;
-                                if (i3 < 0) t2.vtxk = vertices.size() + i3; else    t2.vtxk = i3 - 1;
-                                consumedline = consumedline + offset;
-                                i2 = i3;
-                                indices.push_back(t2);
-                            } else {
-                                consumedline = consumedline + 1;
-                            }
-                        }
-                    }
+            case ObjNormal: {
+                double c[3] = {0, 0, 0};
+                p += 2;
+                for (int n = 0; n < 3 && parseDouble(p, eol, c[n]); n++);
+                normals[normalCount++] = Vector(c[0], c[1], c[2]);
+                break;
+            }
+            case ObjUV: {
+                double c[3] = {0, 0, 0};
+                p += 2;
+                for (int n = 0; n < 3 && parseDouble(p, eol, c[n]); n++);
+                uvs[uvCount++] = Vector(c[0], c[1], c[2]);
+                break;
+            }
+            case ObjFace: {
+                p += 1;
+                int v[3], t[3], n[3];
+                int count = 0;
+                int vi, ti, ni;
+                while (parseFaceVertex(p, eol, vi, ti, ni)) {
+                    int k = count < 2 ? count : 2;
+                    v[k] = resolveObjIndex(vi, vertexCount);
+                    t[k] = resolveObjIndex(ti, uvCount);
+                    n[k] = resolveObjIndex(ni, normalCount);
+                    if (++count < 3) continue;
+                    triangles.push_back(TriangleIndices(v[0], v[1], v[2], n[0], n[1], n[2], t[0], t[1], t[2], curGroup));
+                    // the polygon is split into the fan (0, k - 1, k)
+                    v[1] = v[2];
+                    t[1] = t[2];
+                    n[1] = n[2];
                 }
+                break;
             }
-
+            case ObjMaterial:
+                curGroup++;
+                break;
+            default:
+                break;
         }
-
     }
-    fclose(f);
-
 }
@@ -9,24 +9,65 @@
 #include "Vector.h"
 #include "BoundingBox.h"
 #include "TriangleIndices.h"
-#include "Node.h"
+#include "TriangleIndexStream.h"
+#include "LinearNode.h"
+#include "BVHBuilder.h"
+#include "WideBVH.h"
+#include "TriangleBlock.h"
+#include "MeshOptimizer.h"
+
+class ObjCounts;
 
 class TriangleMesh : public Object {
 public:
     ~TriangleMesh() {}
-    TriangleMesh(const Vector& albedo, bool mirror, bool transparent);
+    TriangleMesh(const Vector& albedo, bool mirror = false, bool transparent = false);
     BoundingBox buildBB(int beginning, int end);
-    void buildBVH(Node* n, int beginning, int end);
-    bool intersect(const Ray& r, Vector& P, Vector& normal, double &t);
-    void readOBJ(const char* obj);
+    void buildBVH();
+    bool intersect(const Ray& r, Vector& P, Vector& normal, Vector& pError, double &t);
+    bool occluded(const Ray& r, double tMax);
+    int intersectPacket(const RayPacket& packet, int mask, double* t, Vector* P, Vector* normal, Vector* pError);
+    BoundingBox bounds();
+    template<typename Leaf>
+    void traverse(const Ray& r, double& tMax, Leaf leaf);
+    void packTriangleBlocks();
+    void computeHit(const Ray& r, int triangle, Vector& P, Vector& normal, Vector& pError, double &t);
+    size_t triangleCount() const { return positionIndices.size(); }
+    void permuteTriangles(const std::vector<int>& order);
+    void compactIndices();
+    size_t indexMemory() const;
+    bool readOBJ(const char* obj, int numberOfThreads = 0);
+    bool loadOBJ(const char* obj, const char* cache, int numberOfThreads = 0);
+    void parseOBJ(const char* begin, const char* end, const ObjCounts& first,
+                  std::vector<TriangleIndices>& triangles, std::vector<Vector>& colors);
 
-    std::vector<TriangleIndices> indices;
+    // vertex indices of every triangle, the only index data needed to trace the mesh
+    TriangleIndexStream positionIndices;
+    // uv and normal indices and group of every triangle, cold data kept apart from positionIndices,
+    // empty if no triangle has them
+    TriangleIndexStream uvIndices;
+    TriangleIndexStream normalIndices;
+    std::vector<int32_t> groups;
     std::vector<Vector> vertices;
     std::vector<Vector> normals;
     std::vector<Vector> uvs;
     std::vector<Vector> vertexcolors;
     BoundingBox bb;
-    Node* BVH;
+    // BVH flattened in depth-first order, nodes[0] is the root, leaves reference ranges of blocks
+    std::vector<LinearNode> nodes;
+    // BVH collapsed to 4 or 8 children per node, filled if bvhSettings.width is 4 or 8
+    std::vector<WideNode<4> > nodes4;
+    std::vector<WideNode<8> > nodes8;
+    // triangles of the BVH leaves, packed for the SIMD intersection
+    std::vector<TriangleBlock> blocks;
+    // settings of the pass loadOBJ runs before building the BVH
+    MeshOptimizerSettings optimizerSettings;
+    // welded vertices and removed triangles of the last loadOBJ
+    MeshOptimizerStatistics optimizerStatistics;
+    // settings used by buildBVH
+    BVHSettings bvhSettings;
+    // size, SAH cost and build time of the last buildBVH
+    BVHStatistics bvhStatistics;
 };
 
 
@@ -5,27 +5,240 @@
 #ifndef HELLOWORLD_VECTOR_H
 #define HELLOWORLD_VECTOR_H
 
-class Vector {
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define HELLOWORLD_SSE 1
+#endif
+
+// scalar type of the renderer, float if it is configured with RAYTRACER_FLOAT
+#ifdef RAYTRACER_FLOAT
+typedef float Scalar;
+#else
+typedef double Scalar;
+#endif
+
+/**
+ * Three component vector, header-only so that every operation is inlined into the kernels.
+ *
+ * The components are padded to four lanes, so a vector is loaded into one SSE (float) or AVX (double)
+ * register. The padding lane carries no meaning and is never read by the scalar accessors.
+ */
+template<typename T>
+class VectorT {
 public:
-    explicit Vector (double x=0, double y=0, double z=0);
-    double operator[](int i) const;
-    double &operator[](int i);
-    Vector& operator+=(const Vector &a);
-    double sqrNorm();
-    Vector getNormalized();
+    typedef T value_type;
+
+    constexpr explicit VectorT (T x=0, T y=0, T z=0) : coords{x, y, z, 0} {};
+    constexpr T operator[](int i) const { return coords[i]; }
+    T &operator[](int i) { return coords[i]; }
+    const T* data() const { return coords; }
+    T* data() { return coords; }
+    inline VectorT& operator+=(const VectorT &a);
+    constexpr T sqrNorm() const { return coords[0]*coords[0] + coords[1]*coords[1] + coords[2]*coords[2]; }
+    VectorT getNormalized() const;
+    inline VectorT getNormalizedFast() const;
 private:
-    double coords[3];
+    alignas(16) T coords[4];
 };
 
-Vector operator+(const Vector &a, const Vector &b);
-Vector operator-(const Vector &a, const Vector &b);
-Vector operator-(const Vector &a);
-Vector operator*(double a, const Vector &b);
-Vector operator*(const Vector &a, double b);
-Vector operator*(const Vector &a, const Vector& b);
-Vector operator/(const Vector &a, double b);
+// scalar factors are not deduced, so that double constants work with float vectors
+template<typename T>
+constexpr VectorT<T> operator+(const VectorT<T> &a, const VectorT<T> &b) {
+    return VectorT<T>(a[0] + b[0], a[1] + b[1], a[2] + b[2]);
+}
+
+template<typename T>
+constexpr VectorT<T> operator-(const VectorT<T> &a, const VectorT<T> &b) {
+    return VectorT<T>(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
+template<typename T>
+constexpr VectorT<T> operator-(const VectorT<T> &a) {
+    return VectorT<T>(-a[0], -a[1], -a[2]);
+}
+
+template<typename T>
+constexpr VectorT<T> operator*(typename VectorT<T>::value_type a, const VectorT<T> &b) {
+    return VectorT<T>(a*b[0], a*b[1], a*b[2]);
+}
+
+template<typename T>
+constexpr VectorT<T> operator*(const VectorT<T> &a, typename VectorT<T>::value_type b) {
+    return VectorT<T>(b*a[0], b*a[1], b*a[2]);
+}
+
+template<typename T>
+constexpr VectorT<T> operator*(const VectorT<T> &a, const VectorT<T>& b) {
+    return VectorT<T>(b[0]*a[0], b[1]*a[1], b[2]*a[2]);
+}
+
+template<typename T>
+constexpr VectorT<T> operator/(const VectorT<T> &a, typename VectorT<T>::value_type b) {
+    return VectorT<T>(a[0]/b, a[1]/b, a[2]/b);
+}
+
+template<typename T>
+constexpr T dot(const VectorT<T> &a, const VectorT<T> &b) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+template<typename T>
+constexpr VectorT<T> cross(const VectorT<T>& a, const VectorT<T>& b) {
+    return VectorT<T>(a[1]*b[2]-a[2]*b[1], a[2]*b[0]-a[0]*b[2], a[0]*b[1]-a[1]*b[0]);
+}
+
+template<typename T>
+inline VectorT<T> absolute(const VectorT<T>& a) {
+    return VectorT<T>(std::fabs(a[0]), std::fabs(a[1]), std::fabs(a[2]));
+}
+
+/**
+ * @return a*u + C, evaluated with fused multiply-adds where the target has them
+ */
+template<typename T>
+constexpr VectorT<T> multiplyAdd(typename VectorT<T>::value_type a, const VectorT<T>& u, const VectorT<T>& C) {
+    return VectorT<T>(a*u[0] + C[0], a*u[1] + C[1], a*u[2] + C[2]);
+}
+
+template<typename T>
+inline VectorT<T>& VectorT<T>::operator+=(const VectorT<T> &a) {
+    *this = *this + a;
+    return *this;
+}
+
+template<typename T>
+inline VectorT<T> VectorT<T>::getNormalized() const {
+    T n = std::sqrt(sqrNorm());
+    return VectorT(coords[0]/n, coords[1]/n, coords[2]/n);
+}
+
+/**
+ * Normalize with a reciprocal square root instead of a square root and three divisions.
+ *
+ * The result is accurate to a few ulps, use getNormalized where the exact quotient matters.
+ */
+template<typename T>
+inline VectorT<T> VectorT<T>::getNormalizedFast() const {
+    return *this * (1 / std::sqrt(sqrNorm()));
+}
+
+#ifdef HELLOWORLD_SSE
+// float vectors fill one SSE register
+
+inline __m128 loadLanes(const VectorT<float>& a) { return _mm_load_ps(a.data()); }
+
+inline VectorT<float> storeLanes(__m128 x) {
+    VectorT<float> r;
+    _mm_store_ps(r.data(), x);
+    return r;
+}
+
+inline VectorT<float> operator+(const VectorT<float> &a, const VectorT<float> &b) {
+    return storeLanes(_mm_add_ps(loadLanes(a), loadLanes(b)));
+}
+
+inline VectorT<float> operator-(const VectorT<float> &a, const VectorT<float> &b) {
+    return storeLanes(_mm_sub_ps(loadLanes(a), loadLanes(b)));
+}
+
+inline VectorT<float> operator*(float a, const VectorT<float> &b) {
+    return storeLanes(_mm_mul_ps(_mm_set1_ps(a), loadLanes(b)));
+}
+
+inline VectorT<float> operator*(const VectorT<float> &a, float b) {
+    return storeLanes(_mm_mul_ps(loadLanes(a), _mm_set1_ps(b)));
+}
+
+inline VectorT<float> operator*(const VectorT<float> &a, const VectorT<float>& b) {
+    return storeLanes(_mm_mul_ps(loadLanes(a), loadLanes(b)));
+}
+
+inline VectorT<float> operator/(const VectorT<float> &a, float b) {
+    return storeLanes(_mm_div_ps(loadLanes(a), _mm_set1_ps(b)));
+}
+
+inline VectorT<float> cross(const VectorT<float>& a, const VectorT<float>& b) {
+    __m128 x = loadLanes(a), y = loadLanes(b);
+    __m128 xYZX = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 0, 2, 1)), yYZX = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 0, 2, 1));
+    // (x * y.yzx - x.yzx * y).yzx
+    __m128 c = _mm_sub_ps(_mm_mul_ps(x, yYZX), _mm_mul_ps(xYZX, y));
+    return storeLanes(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+}
+
+inline VectorT<float> multiplyAdd(float a, const VectorT<float>& u, const VectorT<float>& C) {
+#ifdef __FMA__
+    return storeLanes(_mm_fmadd_ps(_mm_set1_ps(a), loadLanes(u), loadLanes(C)));
+#else
+    return storeLanes(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a), loadLanes(u)), loadLanes(C)));
+#endif
+}
+
+template<>
+inline VectorT<float> VectorT<float>::getNormalizedFast() const {
+    // rsqrt is good to 12 bits, one Newton-Raphson step brings it to float precision
+    __m128 n = _mm_set_ss(sqrNorm());
+    __m128 r = _mm_rsqrt_ss(n);
+    r = _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), r), _mm_sub_ss(_mm_set_ss(3.f), _mm_mul_ss(_mm_mul_ss(n, r), r)));
+    return *this * _mm_cvtss_f32(r);
+}
+#endif
+
+#ifdef __AVX__
+// double vectors fill one AVX register
+
+inline __m256d loadLanes(const VectorT<double>& a) { return _mm256_loadu_pd(a.data()); }
+
+inline VectorT<double> storeLanes(__m256d x) {
+    VectorT<double> r;
+    _mm256_storeu_pd(r.data(), x);
+    return r;
+}
+
+inline VectorT<double> operator+(const VectorT<double> &a, const VectorT<double> &b) {
+    return storeLanes(_mm256_add_pd(loadLanes(a), loadLanes(b)));
+}
+
+inline VectorT<double> operator-(const VectorT<double> &a, const VectorT<double> &b) {
+    return storeLanes(_mm256_sub_pd(loadLanes(a), loadLanes(b)));
+}
+
+inline VectorT<double> operator*(double a, const VectorT<double> &b) {
+    return storeLanes(_mm256_mul_pd(_mm256_set1_pd(a), loadLanes(b)));
+}
+
+inline VectorT<double> operator*(const VectorT<double> &a, double b) {
+    return storeLanes(_mm256_mul_pd(loadLanes(a), _mm256_set1_pd(b)));
+}
+
+inline VectorT<double> operator*(const VectorT<double> &a, const VectorT<double>& b) {
+    return storeLanes(_mm256_mul_pd(loadLanes(a), loadLanes(b)));
+}
+
+inline VectorT<double> operator/(const VectorT<double> &a, double b) {
+    return storeLanes(_mm256_div_pd(loadLanes(a), _mm256_set1_pd(b)));
+}
+
+inline VectorT<double> multiplyAdd(double a, const VectorT<double>& u, const VectorT<double>& C) {
+#ifdef __FMA__
+    return storeLanes(_mm256_fmadd_pd(_mm256_set1_pd(a), loadLanes(u), loadLanes(C)));
+#else
+    return storeLanes(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(a), loadLanes(u)), loadLanes(C)));
+#endif
+}
+
+template<>
+inline VectorT<double> VectorT<double>::getNormalizedFast() const {
+    // single precision estimate, two Newton-Raphson steps in double bring it to about 46 bits
+    double n = sqrNorm();
+    double r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss((float) n)));
+    r = r * (1.5 - 0.5 * n * r * r);
+    r = r * (1.5 - 0.5 * n * r * r);
+    return *this * r;
+}
+#endif
 
-double dot(const Vector &a, const Vector &b);
-Vector cross(const Vector& a, const Vector& b);
+typedef VectorT<Scalar> Vector;
 
 #endif //HELLOWORLD_VECTOR_H
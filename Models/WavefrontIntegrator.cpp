@@ -0,0 +1,331 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "WavefrontIntegrator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include "Morton.h"
+#include "Parallel.h"
+#include "PerfCounter.h"
+#include "ThreadPool.h"
+
+WavefrontIntegrator::WavefrontIntegrator(Renderer& renderer) : renderer(renderer) {
+    queueSize = 1 << 16;
+    numberOfThreads = 0;
+    usePackets = true;
+    sortSecondaryRays = true;
+    compareUnsortedExtend = false;
+    generateTime = sortTime = extendTime = shadeTime = connectTime = regenerateTime = unsortedExtendTime = 0;
+    extendedRays = 0;
+    extendCacheMisses = unsortedExtendCacheMisses = -1;
+    numberOfSamples = nextSample = 0;
+    pool = nullptr;
+}
+
+/**
+ * Render the image of the renderer breadth-first.
+ *
+ * The stages run on a pool of threads started once per render. Terminated paths are accumulated in queue
+ * order on the calling thread, so the image does not depend on the number of threads.
+ *
+ * @param image RGB output of size W*H*3, rows from top to bottom
+ */
+void WavefrontIntegrator::render(std::vector<unsigned char>& image) {
+    int W = renderer.W, H = renderer.H;
+    image.assign(W*H*3, 0);
+    pixelColors.assign(W*H, Vector(0, 0, 0));
+    ThreadPool threads(numberOfThreads);
+    pool = &threads;
+    numberOfSamples = (long long) W*H*renderer.numberOfRays;
+    nextSample = 0;
+    generateTime = sortTime = extendTime = shadeTime = connectTime = regenerateTime = unsortedExtendTime = 0;
+    extendedRays = 0;
+    resize(queueSize);
+    // one cache miss counter per thread of the pool, opened on the thread it counts
+    std::vector<std::unique_ptr<PerfCounter> > cacheMisses(threads.size());
+    threads.run([&](int thread) { cacheMisses[thread].reset(new PerfCounter()); });
+    bool countMisses = true;
+    for (int t = 0; t < threads.size(); t++) {
+        countMisses = countMisses && cacheMisses[t]->isAvailable();
+    }
+    bool compare = compareUnsortedExtend && sortSecondaryRays;
+    extendCacheMisses = countMisses ? 0 : -1;
+    unsortedExtendCacheMisses = countMisses && compare ? 0 : -1;
+
+    // both orders trace the same rays into the same slots, so the second run only repeats the results
+    auto measureExtend = [&](int count, int secondary, bool sorted, double& time, long long& misses) {
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < threads.size(); t++) cacheMisses[t]->start();
+        extend(count, secondary, sorted);
+        for (int t = 0; t < threads.size(); t++) {
+            long long threadMisses = cacheMisses[t]->stop();
+            if (threadMisses >= 0 && misses >= 0) misses += threadMisses;
+        }
+        time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // paths [0, secondary) of the queue have bounced at least once, the rest are new camera paths
+    int count = 0, secondary = 0;
+    for (int batch = 0; ; batch++) {
+        auto start = std::chrono::steady_clock::now();
+        int end = (int) std::min((long long) queueSize, count + numberOfSamples - nextSample);
+        generate(count, end);
+        count = end;
+        auto generated = std::chrono::steady_clock::now();
+        generateTime += std::chrono::duration<double>(generated - start).count();
+        if (count == 0) break;
+
+        if (sortSecondaryRays) sort(secondary);
+        auto sorted = std::chrono::steady_clock::now();
+        sortTime += std::chrono::duration<double>(sorted - generated).count();
+
+        // the order of the two runs alternates, so neither always finds the caches warmed up by the other
+        if (compare && batch % 2 == 0) measureExtend(count, secondary, false, unsortedExtendTime, unsortedExtendCacheMisses);
+        measureExtend(count, secondary, sortSecondaryRays, extendTime, extendCacheMisses);
+        if (compare && batch % 2 == 1) measureExtend(count, secondary, false, unsortedExtendTime, unsortedExtendCacheMisses);
+        extendedRays += count;
+        auto extended = std::chrono::steady_clock::now();
+
+        shade(count);
+        auto shaded = std::chrono::steady_clock::now();
+        shadeTime += std::chrono::duration<double>(shaded - extended).count();
+
+        connect(count);
+        auto connected = std::chrono::steady_clock::now();
+        connectTime += std::chrono::duration<double>(connected - shaded).count();
+
+        count = secondary = regenerate(count);
+        regenerateTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - connected).count();
+    }
+    cacheMisses.clear();
+    pool = nullptr;
+
+    for (int i = 0; i < H; i++) {
+        for (int j = 0; j < W; j++) {
+            renderer.writePixel(image, i, j, pixelColors[i*W + j] / renderer.numberOfRays);
+        }
+    }
+}
+
+void WavefrontIntegrator::resize(int count) {
+    origins.resize(count);
+    directions.resize(count);
+    throughputs.resize(count);
+    radiances.resize(count);
+    pixels.resize(count);
+    samples.resize(count);
+    rebounds.resize(count);
+    lastDiffuse.resize(count);
+    alive.resize(count);
+    hitPoints.resize(count);
+    hitNormals.resize(count);
+    hitErrors.resize(count);
+    hitAlbedos.resize(count);
+    hitObjects.resize(count);
+    hasHit.resize(count);
+    hitMirror.resize(count);
+    hitTransparent.resize(count);
+    shadowOrigins.resize(count);
+    shadowDirections.resize(count);
+    shadowContributions.resize(count);
+    shadowDistances.resize(count);
+    hasShadow.resize(count);
+    rayOrder.resize(count);
+    sortKeys.resize(count);
+}
+
+/**
+ * Start the next camera samples in the slots [beginning, end).
+ *
+ * Samples are numbered pixel by pixel, so sample s is sample s % numberOfRays of pixel s / numberOfRays.
+ */
+void WavefrontIntegrator::generate(int beginning, int end) {
+    long long first = nextSample - beginning;
+    pool->parallelFor(beginning, end, [&](int chunkBeginning, int chunkEnd, int) {
+        for (int i = chunkBeginning; i < chunkEnd; i++) {
+            long long s = first + i;
+            int pixel = (int) (s / renderer.numberOfRays);
+            int k = (int) (s % renderer.numberOfRays);
+            Ray r = renderer.generateRay(pixel / renderer.W, pixel % renderer.W, Sampler(renderer.seed, pixel, k));
+            origins[i] = r.C;
+            directions[i] = r.u;
+            throughputs[i] = Vector(1, 1, 1);
+            radiances[i] = Vector(0, 0, 0);
+            pixels[i] = pixel;
+            samples[i] = k;
+            rebounds[i] = 0;
+            lastDiffuse[i] = false;
+        }
+    });
+    nextSample += end - beginning;
+}
+
+/**
+ * Order the paths which have bounced by the Morton code of their ray origin within the direction octant.
+ *
+ * Diffuse bounces scatter the rays, traced in queue order consecutive rays visit unrelated parts of the
+ * BVHs. Sorted, rays which start close to each other and go in the same general direction are traced one
+ * after the other and find most nodes still in the cache.
+ *
+ * @param secondary number of paths at the front of the queue which have bounced
+ */
+void WavefrontIntegrator::sort(int secondary) {
+    if (secondary < 2) return;
+    BoundingBox b;
+    for (int i = 0; i < secondary; i++) {
+        b.extend(origins[i]);
+    }
+    Vector extent = b.maxi - b.mini;
+    for (int j = 0; j < 3; j++) {
+        extent[j] = extent[j] > 0 ? 1 / extent[j] : 0;
+    }
+
+    // key: 3 bits octant, 30 bits Morton code, 31 bits path index
+    pool->parallelFor(0, secondary, [&](int chunkBeginning, int chunkEnd, int) {
+        for (int i = chunkBeginning; i < chunkEnd; i++) {
+            Vector p = (origins[i] - b.mini) * extent;
+            uint64_t octant = (directions[i][0] < 0) << 2 | (directions[i][1] < 0) << 1 | (directions[i][2] < 0);
+            uint64_t key = octant << 30 | mortonCode(p[0], p[1], p[2]);
+            sortKeys[i] = key << 31 | (uint64_t) i;
+        }
+    });
+    std::sort(sortKeys.begin(), sortKeys.begin() + secondary);
+    for (int i = 0; i < secondary; i++) {
+        rayOrder[i] = (int) (sortKeys[i] & 0x7FFFFFFF);
+    }
+}
+
+/**
+ * Find the closest hit of the current ray of every path.
+ *
+ * Paths which have bounced are traced in the order computed by sort if sorted is set. New paths are appended
+ * to the queue in sample order, so consecutive camera rays belong to the same pixel and are traced as packets.
+ *
+ * @param count number of paths in the queue
+ * @param secondary number of paths at the front of the queue which have bounced
+ * @param sorted trace the paths which have bounced in the order computed by sort, else in queue order
+ */
+void WavefrontIntegrator::extend(int count, int secondary, bool sorted) {
+    Scene& scene = renderer.scene;
+    sorted = sorted && secondary > 1;
+    pool->parallelFor(0, count, [&](int chunkBeginning, int chunkEnd, int) {
+        for (int k = chunkBeginning; k < chunkEnd; k++) {
+            int i = k < secondary && sorted ? rayOrder[k] : k;
+
+            int n = 0;
+            while (usePackets && k >= secondary && n < RayPacketSize && k + n < chunkEnd && rebounds[k + n] == 0) n++;
+            if (n > 1) {
+                bool mirror[RayPacketSize], transparent[RayPacketSize], hit[RayPacketSize];
+                double t[RayPacketSize];
+                scene.intersectPacket(&origins[i], &directions[i], n, &hitPoints[i], &hitNormals[i], &hitErrors[i],
+                                      &hitAlbedos[i], mirror, transparent, t, &hitObjects[i], hit);
+                for (int lane = 0; lane < n; lane++) {
+                    hasHit[i + lane] = hit[lane];
+                    hitMirror[i + lane] = mirror[lane];
+                    hitTransparent[i + lane] = transparent[lane];
+                }
+                k += n - 1;
+                continue;
+            }
+
+            bool mirror, transparent;
+            double t;
+            hasHit[i] = scene.intersect(Ray(origins[i], directions[i]), hitPoints[i], hitNormals[i], hitErrors[i],
+                                        hitAlbedos[i], mirror, transparent, t, hitObjects[i]);
+            hitMirror[i] = mirror;
+            hitTransparent[i] = transparent;
+        }
+    });
+}
+
+/**
+ * Evaluate the hit of every path with Scene::shade: add emitted light, set up the shadow ray for direct
+ * lighting and replace the ray of the path by the scattered one. Paths that miss or are terminated by
+ * shade are marked as not alive.
+ */
+void WavefrontIntegrator::shade(int count) {
+    Scene& scene = renderer.scene;
+    pool->parallelFor(0, count, [&](int chunkBeginning, int chunkEnd, int) {
+        for (int i = chunkBeginning; i < chunkEnd; i++) {
+            hasShadow[i] = false;
+            alive[i] = false;
+            if (!hasHit[i]) continue;
+
+            Hit hit;
+            hit.P = hitPoints[i];
+            hit.N = hitNormals[i];
+            hit.pError = hitErrors[i];
+            hit.albedo = hitAlbedos[i];
+            hit.mirror = hitMirror[i];
+            hit.transparent = hitTransparent[i];
+            hit.objectid = hitObjects[i];
+            PathState path;
+            path.throughput = throughputs[i];
+            path.radiance = radiances[i];
+            path.lastDiffuse = lastDiffuse[i];
+            path.rebound = rebounds[i];
+
+            Ray r(origins[i], directions[i]);
+            Ray next = r, shadowRay = r;
+            double shadowDistance;
+            alive[i] = scene.shade(r, hit, path, Sampler(renderer.seed, pixels[i], samples[i]),
+                                   next, shadowRay, shadowDistance, shadowContributions[i]);
+            throughputs[i] = path.throughput;
+            radiances[i] = path.radiance;
+            lastDiffuse[i] = path.lastDiffuse;
+            if (shadowDistance > 0) {
+                hasShadow[i] = true;
+                shadowOrigins[i] = shadowRay.C;
+                shadowDirections[i] = shadowRay.u;
+                shadowDistances[i] = shadowDistance;
+            }
+            origins[i] = next.C;
+            directions[i] = next.u;
+            rebounds[i]++;
+        }
+    });
+}
+
+/**
+ * Trace the shadow rays of the shade stage and add the light they carry to their path.
+ */
+void WavefrontIntegrator::connect(int count) {
+    Scene& scene = renderer.scene;
+    pool->parallelFor(0, count, [&](int chunkBeginning, int chunkEnd, int) {
+        for (int i = chunkBeginning; i < chunkEnd; i++) {
+            if (hasShadow[i] && !scene.occluded(Ray(shadowOrigins[i], shadowDirections[i]), shadowDistances[i])) {
+                radiances[i] += shadowContributions[i];
+            }
+        }
+    });
+}
+
+/**
+ * Add the radiance of terminated paths to their pixel and move the remaining paths to the front of the queue.
+ *
+ * @return number of paths still alive
+ */
+int WavefrontIntegrator::regenerate(int count) {
+    int alivePaths = 0;
+    for (int i = 0; i < count; i++) {
+        if (!alive[i]) {
+            pixelColors[pixels[i]] += radiances[i];
+            continue;
+        }
+        if (alivePaths != i) {
+            origins[alivePaths] = origins[i];
+            directions[alivePaths] = directions[i];
+            throughputs[alivePaths] = throughputs[i];
+            radiances[alivePaths] = radiances[i];
+            pixels[alivePaths] = pixels[i];
+            samples[alivePaths] = samples[i];
+            rebounds[alivePaths] = rebounds[i];
+            lastDiffuse[alivePaths] = lastDiffuse[i];
+        }
+        alivePaths++;
+    }
+    return alivePaths;
+}
@@ -0,0 +1,86 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_WAVEFRONTINTEGRATOR_H
+#define HELLOWORLD_WAVEFRONTINTEGRATOR_H
+
+#include <cstdint>
+#include <vector>
+#include "Vector.h"
+#include "Ray.h"
+#include "Renderer.h"
+
+class ThreadPool;
+
+/**
+ * Breadth-first path tracer.
+ *
+ * Instead of following one path to the end before starting the next, a queue of paths is advanced one bounce at a
+ * time in separate stages: generate camera rays, extend (closest hit), shade, connect (shadow rays) and regenerate
+ * the slots of terminated paths. Every stage runs one tight loop over the whole queue, so the same code and scene
+ * data stay hot in the cache. It computes the same estimator as Scene::getColor with the camera of the renderer.
+ */
+class WavefrontIntegrator {
+public:
+    WavefrontIntegrator(Renderer& renderer);
+    void render(std::vector<unsigned char>& image);
+
+    Renderer& renderer;
+    // maximum number of paths in flight
+    int queueSize;
+    // number of worker threads, 0 means one per hardware thread
+    int numberOfThreads;
+    // trace the camera rays as packets of RayPacketSize rays
+    bool usePackets;
+    // trace the rays after a bounce in the order of their origin cell and direction octant
+    bool sortSecondaryRays;
+    // trace every batch a second time in queue order to measure what sorting saves, doubles the extend work
+    bool compareUnsortedExtend;
+
+    // time in seconds spent in each stage during the last render
+    double generateTime, sortTime, extendTime, shadeTime, connectTime, regenerateTime;
+    // number of rays traced in the extend stage
+    long long extendedRays;
+    // hardware cache misses during the extend stage, -1 if the counter is not available
+    long long extendCacheMisses;
+    // time and cache misses of the extend stage in queue order, measured if compareUnsortedExtend is set
+    // and the rays are sorted, the misses are -1 otherwise
+    double unsortedExtendTime;
+    long long unsortedExtendCacheMisses;
+
+private:
+    void generate(int beginning, int end);
+    void sort(int secondary);
+    void extend(int count, int secondary, bool sorted);
+    void shade(int count);
+    void connect(int count);
+    int regenerate(int count);
+    void resize(int count);
+
+    // number of samples of the image and index of the next one to start
+    long long numberOfSamples, nextSample;
+    // sum of the finished samples of every pixel
+    std::vector<Vector> pixelColors;
+    // threads of the running render
+    ThreadPool* pool;
+    // order in which extend traces the paths after a bounce
+    std::vector<int> rayOrder;
+    std::vector<uint64_t> sortKeys;
+
+    // path state, one entry per queue slot
+    std::vector<Vector> origins, directions, throughputs, radiances;
+    std::vector<int> pixels, samples, rebounds;
+    std::vector<char> lastDiffuse, alive;
+    // closest hit of the current ray
+    std::vector<Vector> hitPoints, hitNormals, hitErrors, hitAlbedos;
+    std::vector<int> hitObjects;
+    std::vector<char> hasHit, hitMirror, hitTransparent;
+    // shadow ray towards the light and the radiance it carries if it is unblocked
+    std::vector<Vector> shadowOrigins, shadowDirections, shadowContributions;
+    std::vector<double> shadowDistances;
+    std::vector<char> hasShadow;
+};
+
+
+#endif //HELLOWORLD_WAVEFRONTINTEGRATOR_H
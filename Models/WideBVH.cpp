@@ -0,0 +1,108 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <cmath>
+#include <limits>
+#include "WideBVH.h"
+
+WideRay::WideRay(const Ray& r) {
+    for (int j = 0; j < 3; j++) {
+        C[j] = (float) r.C[j];
+        u[j] = (float) r.u[j];
+        double inv = 1./r.u[j];
+        // keep the inverse finite, so that (bound - C) * invU never evaluates 0 * inf
+        if (!(std::fabs(inv) < 1E30)) inv = std::copysign(1E30, r.u[j]);
+        invU[j] = (float) inv;
+        dirIsNeg[j] = invU[j] < 0;
+    }
+}
+
+static double nodeArea(const LinearNode& n) {
+    double dx = n.maxi[0] - n.mini[0], dy = n.maxi[1] - n.mini[1], dz = n.maxi[2] - n.mini[2];
+    return 2*(dx*dy + dy*dz + dz*dx);
+}
+
+/**
+ * Collapse the subtree of a binary node into a wide node.
+ *
+ * The children of the binary node are opened greedily, always the inner child with the largest
+ * surface area first, until the wide node holds N children or only leaves are left.
+ *
+ * @return index of the wide node
+ */
+template<int N>
+static int collapseNode(const std::vector<LinearNode>& binary, int binaryIndex, std::vector<WideNode<N> >& wide) {
+    int index = wide.size();
+    wide.push_back(WideNode<N>());
+
+    int children[N];
+    int n = 0;
+    if (binary[binaryIndex].isLeaf()) {
+        children[n++] = binaryIndex;
+    } else {
+        children[n++] = binaryIndex + 1;
+        children[n++] = binary[binaryIndex].offset;
+    }
+    while (n < N) {
+        int best = -1;
+        double bestArea = -1;
+        for (int i = 0; i < n; i++) {
+            const LinearNode& c = binary[children[i]];
+            if (!c.isLeaf() && nodeArea(c) > bestArea) {
+                bestArea = nodeArea(c);
+                best = i;
+            }
+        }
+        if (best < 0) break;
+        int opened = children[best];
+        children[best] = opened + 1;
+        children[n++] = binary[opened].offset;
+    }
+
+    for (int i = 0; i < N; i++) {
+        WideNode<N>& node = wide[index];
+        if (i >= n) {
+            for (int axis = 0; axis < 3; axis++) {
+                node.bounds[axis][i] = std::numeric_limits<float>::infinity();
+                node.bounds[3 + axis][i] = -std::numeric_limits<float>::infinity();
+            }
+            node.child[i] = 0;
+            node.count[i] = -1;
+            continue;
+        }
+        const LinearNode& c = binary[children[i]];
+        for (int axis = 0; axis < 3; axis++) {
+            node.bounds[axis][i] = c.mini[axis];
+            node.bounds[3 + axis][i] = c.maxi[axis];
+        }
+        if (c.isLeaf()) {
+            node.child[i] = c.offset;
+            node.count[i] = c.count;
+        } else {
+            node.count[i] = 0;
+            // the recursion may grow wide, so the node is looked up again afterwards
+            int childIndex = collapseNode<N>(binary, children[i], wide);
+            wide[index].child[i] = childIndex;
+        }
+    }
+    return index;
+}
+
+/**
+ * Collapse a flattened binary BVH into a BVH with N children per node.
+ *
+ * @param binary flattened binary BVH
+ * @param wide collapsed BVH, wide[0] is the root
+ */
+template<int N>
+void collapseBVH(const std::vector<LinearNode>& binary, std::vector<WideNode<N> >& wide) {
+    wide.clear();
+    if (binary.empty()) return;
+    wide.reserve(binary.size() / (N - 1) + 1);
+    collapseNode<N>(binary, 0, wide);
+    wide.shrink_to_fit();
+}
+
+template void collapseBVH<4>(const std::vector<LinearNode>& binary, std::vector<WideNode<4> >& wide);
+template void collapseBVH<8>(const std::vector<LinearNode>& binary, std::vector<WideNode<8> >& wide);
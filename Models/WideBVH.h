@@ -0,0 +1,166 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_WIDEBVH_H
+#define HELLOWORLD_WIDEBVH_H
+
+#include <cstdint>
+#include <vector>
+#include "Ray.h"
+#include "LinearNode.h"
+
+/**
+ * Node of a 4- or 8-wide BVH, collapsed from the binary BVH.
+ *
+ * The bounds of all children are stored as structure of arrays in single precision, so that a single
+ * SSE (N = 4) or AVX (N = 8) slab test covers all of them.
+ */
+template<int N>
+class WideNode {
+public:
+    // bounds[axis][i] is the lower and bounds[3 + axis][i] the upper bound of child i
+    float bounds[6][N];
+    // inner child: index of the wide node, leaf: index of the first primitive
+    int32_t child[N];
+    // number of primitives of a leaf child, 0 for an inner child, -1 for an empty slot
+    int32_t count[N];
+};
+
+// ray in the form used by the wide node test
+class WideRay {
+public:
+    WideRay() {}
+    explicit WideRay(const Ray& r);
+
+    float C[3];
+    float u[3];
+    // component-wise inverse of the direction, clamped to finite values
+    float invU[3];
+    // 1 if the direction is negative along the axis
+    int dirIsNeg[3];
+};
+
+template<int N>
+void collapseBVH(const std::vector<LinearNode>& binary, std::vector<WideNode<N> >& wide);
+
+// slab tests are evaluated in float, the far distance is enlarged by 1 + 2*gamma(3) to stay conservative
+static const float WideSlabTolerance = 1.0000004f;
+
+/**
+ * Slab test of a ray against all children of a wide node.
+ *
+ * @param tMax end of the ray segment
+ * @param tEntry distance at which the ray enters every child
+ * @return bit mask of the children entered before tMax
+ */
+template<int N>
+inline int intersectChildren(const WideNode<N>& node, const WideRay& r, float tMax, float* tEntry) {
+    int mask = 0;
+    for (int i = 0; i < N; i++) {
+        float tNear = 0, tFar = tMax;
+        for (int axis = 0; axis < 3; axis++) {
+            float t1 = (node.bounds[axis + 3*r.dirIsNeg[axis]][i] - r.C[axis]) * r.invU[axis];
+            float t2 = (node.bounds[axis + 3*(1 - r.dirIsNeg[axis])][i] - r.C[axis]) * r.invU[axis];
+            tNear = t1 > tNear ? t1 : tNear;
+            tFar = t2 < tFar ? t2 : tFar;
+        }
+        tEntry[i] = tNear;
+        if (tNear <= tFar * WideSlabTolerance) mask |= 1 << i;
+    }
+    return mask;
+}
+
+#ifdef HELLOWORLD_SSE
+template<>
+inline int intersectChildren<4>(const WideNode<4>& node, const WideRay& r, float tMax, float* tEntry) {
+    __m128 tNear = _mm_setzero_ps();
+    __m128 tFar = _mm_set1_ps(tMax);
+    for (int axis = 0; axis < 3; axis++) {
+        __m128 C = _mm_set1_ps(r.C[axis]);
+        __m128 invU = _mm_set1_ps(r.invU[axis]);
+        __m128 nearPlane = _mm_loadu_ps(node.bounds[axis + 3*r.dirIsNeg[axis]]);
+        __m128 farPlane = _mm_loadu_ps(node.bounds[axis + 3*(1 - r.dirIsNeg[axis])]);
+        tNear = _mm_max_ps(tNear, _mm_mul_ps(_mm_sub_ps(nearPlane, C), invU));
+        tFar = _mm_min_ps(tFar, _mm_mul_ps(_mm_sub_ps(farPlane, C), invU));
+    }
+    tFar = _mm_mul_ps(tFar, _mm_set1_ps(WideSlabTolerance));
+    _mm_storeu_ps(tEntry, tNear);
+    return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+}
+#endif
+
+#ifdef __AVX__
+template<>
+inline int intersectChildren<8>(const WideNode<8>& node, const WideRay& r, float tMax, float* tEntry) {
+    __m256 tNear = _mm256_setzero_ps();
+    __m256 tFar = _mm256_set1_ps(tMax);
+    for (int axis = 0; axis < 3; axis++) {
+        __m256 C = _mm256_set1_ps(r.C[axis]);
+        __m256 invU = _mm256_set1_ps(r.invU[axis]);
+        __m256 nearPlane = _mm256_loadu_ps(node.bounds[axis + 3*r.dirIsNeg[axis]]);
+        __m256 farPlane = _mm256_loadu_ps(node.bounds[axis + 3*(1 - r.dirIsNeg[axis])]);
+        tNear = _mm256_max_ps(tNear, _mm256_mul_ps(_mm256_sub_ps(nearPlane, C), invU));
+        tFar = _mm256_min_ps(tFar, _mm256_mul_ps(_mm256_sub_ps(farPlane, C), invU));
+    }
+    tFar = _mm256_mul_ps(tFar, _mm256_set1_ps(WideSlabTolerance));
+    _mm256_storeu_ps(tEntry, tNear);
+    return _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ));
+}
+#endif
+
+/**
+ * Traverse a wide BVH front to back.
+ *
+ * The children hit by the ray are sorted by entry distance and pushed far to near, entries which
+ * start behind the closest hit found so far are skipped when they are popped.
+ *
+ * @param nodes wide BVH, nodes[0] is the root
+ * @param r incoming ray
+ * @param tMax closest hit so far, updated by leaf
+ * @param leaf called as leaf(first, count) for every leaf reached, it returns true to stop the traversal
+ */
+template<int N, typename Leaf>
+inline void traverseWideBVH(const std::vector<WideNode<N> >& nodes, const Ray& r, double& tMax, Leaf leaf) {
+    struct Entry {
+        int32_t child, count;
+        float t;
+    };
+    Entry stack[BVHStackSize * (N - 1) + 1];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, 0.f};
+
+    WideRay wr(r);
+    alignas(32) float tEntry[N];
+    while (stackSize > 0) {
+        Entry e = stack[--stackSize];
+        if (e.t > tMax * WideSlabTolerance) continue;
+        if (e.count > 0) {
+            if (leaf(e.child, e.count)) return;
+            continue;
+        }
+
+        const WideNode<N>& node = nodes[e.child];
+        int mask = intersectChildren<N>(node, wr, (float) tMax, tEntry);
+        if (!mask) continue;
+
+        // insertion sort of the hit children, far to near
+        Entry hits[N];
+        int nHits = 0;
+        for (int i = 0; i < N; i++) {
+            if (!(mask & (1 << i)) || node.count[i] < 0) continue;
+            Entry h = {node.child[i], node.count[i], tEntry[i]};
+            int k = nHits++;
+            while (k > 0 && hits[k - 1].t < h.t) {
+                hits[k] = hits[k - 1];
+                k--;
+            }
+            hits[k] = h;
+        }
+        for (int i = 0; i < nHits; i++) {
+            stack[stackSize++] = hits[i];
+        }
+    }
+}
+
+#endif //HELLOWORLD_WIDEBVH_H
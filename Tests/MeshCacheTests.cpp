@@ -0,0 +1,216 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "Models/MeshCache.h"
+#include "Models/TriangleMesh.h"
+#include "Tests/Test.h"
+
+/**
+ * Wavy grid of n x n quads with uvs, normals and two materials.
+ */
+static std::string gridObj(int n) {
+    std::ostringstream obj;
+    for (int i = 0; i <= n; i++) {
+        for (int j = 0; j <= n; j++) {
+            obj << "v " << i << " " << (i * j) % 5 << " " << j << "\n";
+            obj << "vt " << i / (double) n << " " << j / (double) n << "\n";
+        }
+    }
+    obj << "vn 0 1 0\n";
+    for (int i = 0; i < n; i++) {
+        if (i == n / 2) obj << "usemtl second\n";
+        for (int j = 0; j < n; j++) {
+            int a = i * (n + 1) + j + 1, b = a + n + 1;
+            obj << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << b + 1 << "/" << b + 1 << "/1 "
+                << a + 1 << "/" << a + 1 << "/1\n";
+        }
+    }
+    return obj.str();
+}
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+static uint64_t keyOf(const std::string& data, const TriangleMesh& mesh) {
+    return MeshCache::key(data.data(), data.size(), mesh.optimizerSettings, mesh.bvhSettings, 1);
+}
+
+template<typename T>
+static bool sameBytes(const std::vector<T>& a, const std::vector<T>& b) {
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+static bool sameStream(const TriangleIndexStream& a, const TriangleIndexStream& b) {
+    return a.isNarrow == b.isNarrow && sameBytes(a.narrow, b.narrow) && sameBytes(a.wide, b.wide);
+}
+
+/**
+ * A mesh parsed, optimized and built the way loadOBJ does it, and its cache key.
+ */
+static uint64_t buildMesh(TriangleMesh& mesh, const std::string& objPath, int width) {
+    mesh.bvhSettings.splitMethod = SAHSplit;
+    mesh.bvhSettings.width = width;
+    mesh.readOBJ(objPath.c_str(), 1);
+    MeshOptimizer::optimize(mesh, mesh.optimizerSettings, mesh.optimizerStatistics, 1);
+    mesh.buildBVH();
+    return keyOf(readFile(objPath), mesh);
+}
+
+TEST(MeshCache, RoundTrip) {
+    std::string objPath = testFile("grid.obj"), cachePath = testFile("grid.meshcache");
+    CHECK(writeTextFile(objPath, gridObj(40)));
+    for (int width : {2, 4, 8}) {
+        TriangleMesh mesh(Vector(1, 1, 1));
+        uint64_t key = buildMesh(mesh, objPath, width);
+        CHECK(MeshCache::save(mesh, cachePath.c_str(), key));
+
+        TriangleMesh loaded(Vector(1, 1, 1));
+        CHECK(MeshCache::load(loaded, cachePath.c_str(), key));
+        CHECK(sameBytes(loaded.vertices, mesh.vertices));
+        CHECK(sameBytes(loaded.uvs, mesh.uvs));
+        CHECK(sameBytes(loaded.normals, mesh.normals));
+        CHECK(sameStream(loaded.positionIndices, mesh.positionIndices));
+        CHECK(sameStream(loaded.uvIndices, mesh.uvIndices));
+        CHECK(sameStream(loaded.normalIndices, mesh.normalIndices));
+        CHECK(loaded.groups == mesh.groups);
+        CHECK(sameBytes(loaded.nodes, mesh.nodes));
+        CHECK(sameBytes(loaded.nodes4, mesh.nodes4));
+        CHECK(sameBytes(loaded.nodes8, mesh.nodes8));
+        CHECK(sameBytes(loaded.blocks, mesh.blocks));
+        CHECK_EQUAL(loaded.bvhStatistics.numberOfNodes, mesh.bvhStatistics.numberOfNodes);
+
+        std::mt19937 generator(width);
+        std::uniform_real_distribution<double> position(-5, 45), direction(-1, 1);
+        bool sameHits = true;
+        for (int i = 0; i < 10000; i++) {
+            Ray r(Vector(position(generator), position(generator), position(generator)),
+                  Vector(direction(generator), direction(generator), direction(generator)).getNormalized());
+            Vector P1, N1, E1, P2, N2, E2;
+            double t1, t2;
+            bool hit1 = mesh.intersect(r, P1, N1, E1, t1), hit2 = loaded.intersect(r, P2, N2, E2, t2);
+            sameHits = sameHits && hit1 == hit2 && (!hit1 || t1 == t2);
+        }
+        CHECK(sameHits);
+    }
+    remove(objPath.c_str());
+    remove(cachePath.c_str());
+}
+
+TEST(MeshCache, KeyDependsOnContentAndSettings) {
+    std::string data = gridObj(10);
+    TriangleMesh mesh(Vector(1, 1, 1));
+    uint64_t key = keyOf(data, mesh);
+    CHECK_EQUAL(MeshCache::key(data.data(), data.size(), mesh.optimizerSettings, mesh.bvhSettings, 4), key);
+
+    std::string edited = data;
+    edited[edited.size() / 2] = edited[edited.size() / 2] == '1' ? '2' : '1';
+    CHECK(keyOf(edited, mesh) != key);
+    CHECK(keyOf(data + "\n", mesh) != key);
+
+    TriangleMesh other(Vector(1, 1, 1));
+    other.bvhSettings.width = mesh.bvhSettings.width == 8 ? 4 : 8;
+    CHECK(keyOf(data, other) != key);
+    other = TriangleMesh(Vector(1, 1, 1));
+    other.bvhSettings.splitMethod = mesh.bvhSettings.splitMethod == SAHSplit ? MiddleSplit : SAHSplit;
+    CHECK(keyOf(data, other) != key);
+    other = TriangleMesh(Vector(1, 1, 1));
+    other.optimizerSettings.weldTolerance = 1E-6;
+    CHECK(keyOf(data, other) != key);
+    other = TriangleMesh(Vector(1, 1, 1));
+    other.optimizerSettings.reorder = !mesh.optimizerSettings.reorder;
+    CHECK(keyOf(data, other) != key);
+}
+
+TEST(MeshCache, EditedSourceIsReparsed) {
+    std::string objPath = testFile("edited.obj"), cachePath = testFile("edited.meshcache");
+    CHECK(writeTextFile(objPath, gridObj(10)));
+    TriangleMesh first(Vector(1, 1, 1));
+    CHECK(first.loadOBJ(objPath.c_str(), cachePath.c_str(), 1));
+    CHECK_EQUAL(first.triangleCount(), 200);
+
+    CHECK(writeTextFile(objPath, gridObj(12)));
+    TriangleMesh second(Vector(1, 1, 1));
+    CHECK(second.loadOBJ(objPath.c_str(), cachePath.c_str(), 1));
+    CHECK_EQUAL(second.triangleCount(), 288);
+    uint64_t key = keyOf(readFile(objPath), second);
+    TriangleMesh cached(Vector(1, 1, 1));
+    CHECK(MeshCache::load(cached, cachePath.c_str(), key));
+    CHECK_EQUAL(cached.triangleCount(), 288);
+    CHECK(!MeshCache::load(cached, cachePath.c_str(), key + 1));
+    remove(objPath.c_str());
+    remove(cachePath.c_str());
+}
+
+/**
+ * Save a cache, overwrite an int32 or uint16 of one of its arrays and check that it is rejected.
+ *
+ * @param byteOffset position of the value within the array
+ */
+template<typename T>
+static bool rejectsPatchedValue(const TriangleMesh& mesh, uint64_t key, MeshCacheArray array, size_t byteOffset, T value) {
+    std::string cachePath = testFile("patched.meshcache");
+    if (!MeshCache::save(mesh, cachePath.c_str(), key)) return false;
+    std::string content = readFile(cachePath);
+    MeshCacheHeader header;
+    memcpy(&header, content.data(), sizeof(header));
+    memcpy(&content[header.offsets[array] + byteOffset], &value, sizeof(T));
+    writeTextFile(cachePath, content);
+
+    TriangleMesh loaded(Vector(1, 1, 1));
+    bool loadedAnyway = MeshCache::load(loaded, cachePath.c_str(), key);
+    remove(cachePath.c_str());
+    // a rejected cache leaves the mesh untouched
+    return !loadedAnyway && loaded.vertices.empty() && loaded.nodes.empty();
+}
+
+TEST(MeshCache, RejectsIndicesOutOfRange) {
+    std::string objPath = testFile("corrupt.obj");
+    CHECK(writeTextFile(objPath, gridObj(40)));
+    TriangleMesh mesh(Vector(1, 1, 1));
+    uint64_t key = buildMesh(mesh, objPath, 8);
+    remove(objPath.c_str());
+    CHECK(mesh.positionIndices.isNarrow);
+
+    // 16-bit streams: one past the last vertex, and the missing index where none is allowed
+    uint16_t vertices = (uint16_t) mesh.vertices.size();
+    CHECK(rejectsPatchedValue(mesh, key, CachedPositionIndices, 2 * sizeof(uint16_t), vertices));
+    CHECK(rejectsPatchedValue(mesh, key, CachedPositionIndices, 0, (uint16_t) 0xFFFF));
+    CHECK(rejectsPatchedValue(mesh, key, CachedUVIndices, 0, (uint16_t) mesh.uvs.size()));
+    CHECK(rejectsPatchedValue(mesh, key, CachedNormalIndices, 0, (uint16_t) mesh.normals.size()));
+
+    // 32-bit streams
+    TriangleMesh wide = mesh;
+    wide.positionIndices.widen();
+    CHECK(rejectsPatchedValue(wide, key, CachedPositionIndices, sizeof(int32_t), (int32_t) wide.vertices.size()));
+    CHECK(rejectsPatchedValue(wide, key, CachedPositionIndices, 0, (int32_t) -1));
+
+    // the second child of the root, the first block of a leaf, the child of a wide node, a block lane
+    CHECK(!mesh.nodes[0].isLeaf());
+    CHECK(rejectsPatchedValue(mesh, key, CachedNodes, offsetof(LinearNode, offset), (int32_t) mesh.nodes.size()));
+    CHECK(rejectsPatchedValue(mesh, key, CachedNodes, offsetof(LinearNode, offset), (int32_t) 0));
+    size_t leaf = 0;
+    while (leaf < mesh.nodes.size() && !mesh.nodes[leaf].isLeaf()) leaf++;
+    CHECK(rejectsPatchedValue(mesh, key, CachedNodes, leaf * sizeof(LinearNode) + offsetof(LinearNode, offset),
+                              (int32_t) mesh.blocks.size()));
+    int inner = 0;
+    while (inner < 8 && mesh.nodes8[0].count[inner] != 0) inner++;
+    CHECK(inner < 8);
+    CHECK(rejectsPatchedValue(mesh, key, CachedNodes8, offsetof(WideNode<8>, child) + inner * sizeof(int32_t),
+                              (int32_t) mesh.nodes8.size()));
+    CHECK(rejectsPatchedValue(mesh, key, CachedBlocks, offsetof(TriangleBlock, triangle), (int32_t) mesh.triangleCount()));
+
+    // a value which stays in range is accepted
+    CHECK(!rejectsPatchedValue(mesh, key, CachedBlocks, offsetof(TriangleBlock, triangle), (int32_t) 0));
+}
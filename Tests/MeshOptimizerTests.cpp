@@ -0,0 +1,83 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <set>
+#include "Models/MeshOptimizer.h"
+#include "Models/TriangleMesh.h"
+#include "Tests/Test.h"
+
+/**
+ * Two triangles of a unit square stored with duplicated corners, next to a flat and a collapsing
+ * triangle and a vertex no triangle uses:
+ * - vertices 3 and 4 repeat 1 and 2 exactly, 6 is within the tolerance of 0
+ * - triangle 2 has collinear corners, triangle 3 becomes (0, 2, 0) once 6 is welded to 0
+ * - vertex 7 is only used by triangle 2, vertex 8 by none
+ */
+static void buildSquare(TriangleMesh& mesh) {
+    Vector corners[] = {Vector(0, 0, 0), Vector(1, 0, 0), Vector(0, 1, 0), Vector(1, 0, 0), Vector(0, 1, 0),
+                        Vector(1, 1, 0), Vector(1E-12, 0, 0), Vector(2, 0, 0), Vector(5, 5, 5)};
+    mesh.vertices.assign(corners, corners + 9);
+    mesh.positionIndices.push_back(0, 1, 2);
+    mesh.positionIndices.push_back(3, 5, 4);
+    mesh.positionIndices.push_back(0, 1, 7);
+    mesh.positionIndices.push_back(0, 2, 6);
+}
+
+// x + 2y of every corner of a triangle, which tells the corners of the unit square apart
+static std::multiset<double> cornerCodes(const TriangleMesh& mesh, int triangle) {
+    int a, b, c;
+    mesh.positionIndices.get(triangle, a, b, c);
+    std::multiset<double> codes;
+    for (int v : {a, b, c}) {
+        codes.insert(mesh.vertices[v][0] + 2 * mesh.vertices[v][1]);
+    }
+    return codes;
+}
+
+TEST(MeshOptimizer, CountsOnADuplicatedSquare) {
+    TriangleMesh mesh(Vector(1, 1, 1));
+    buildSquare(mesh);
+    MeshOptimizerStatistics statistics;
+    MeshOptimizer::optimize(mesh, MeshOptimizerSettings(), statistics, 1);
+    CHECK_EQUAL(statistics.weldedVertices, 3);
+    CHECK_EQUAL(statistics.degenerateTriangles, 2);
+    CHECK_EQUAL(statistics.unusedVertices, 2);
+    CHECK_EQUAL(mesh.vertices.size(), 4);
+    CHECK_EQUAL(mesh.triangleCount(), 2);
+    if (mesh.triangleCount() != 2) return;
+
+    // the two halves of the square are left, sharing the vertices of their common edge
+    std::multiset<double> lower = {0, 1, 2}, upper = {1, 2, 3};
+    std::multiset<double> first = cornerCodes(mesh, 0), second = cornerCodes(mesh, 1);
+    CHECK((first == lower && second == upper) || (first == upper && second == lower));
+    std::set<int> used;
+    for (int t = 0; t < 2; t++) {
+        int a, b, c;
+        mesh.positionIndices.get(t, a, b, c);
+        used.insert({a, b, c});
+    }
+    CHECK_EQUAL(used.size(), 4);
+    // vertices are numbered in the order the triangles first use them
+    int a, b, c;
+    mesh.positionIndices.get(0, a, b, c);
+    CHECK(a == 0 && b == 1 && c == 2);
+}
+
+TEST(MeshOptimizer, ZeroToleranceWeldsExactDuplicatesOnly) {
+    TriangleMesh mesh(Vector(1, 1, 1));
+    buildSquare(mesh);
+    CHECK_EQUAL(MeshOptimizer::weldVertices(mesh, 0), 2);
+    CHECK_EQUAL(mesh.vertices.size(), 7);
+    // vertex 6 stays apart, so only the collinear triangle is dropped
+    CHECK_EQUAL(MeshOptimizer::removeDegenerateTriangles(mesh), 1);
+}
+
+TEST(MeshOptimizer, DifferentColorsAreNotWelded) {
+    TriangleMesh mesh(Vector(1, 1, 1));
+    buildSquare(mesh);
+    mesh.vertexcolors.assign(mesh.vertices.size(), Vector(1, 1, 1));
+    mesh.vertexcolors[3] = Vector(1, 0, 0);
+    CHECK_EQUAL(MeshOptimizer::weldVertices(mesh, 1E-9), 2);
+    CHECK_EQUAL(mesh.vertexcolors.size(), mesh.vertices.size());
+}
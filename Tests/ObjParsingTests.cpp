@@ -0,0 +1,154 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Models/TriangleMesh.h"
+#include "Tests/Test.h"
+
+static bool sameVectors(const std::vector<Vector>& a, const std::vector<Vector>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i][0] != b[i][0] || a[i][1] != b[i][1] || a[i][2] != b[i][2]) return false;
+    }
+    return true;
+}
+
+// compared through get, so that a narrow and a wide stream with the same indices are equal
+static bool sameStream(const TriangleIndexStream& a, const TriangleIndexStream& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t t = 0; t < a.size(); t++) {
+        int ai, aj, ak, bi, bj, bk;
+        a.get(t, ai, aj, ak);
+        b.get(t, bi, bj, bk);
+        if (ai != bi || aj != bj || ak != bk) return false;
+    }
+    return true;
+}
+
+static bool hasIndices(const TriangleIndexStream& stream, size_t triangle, int i, int j, int k) {
+    int a, b, c;
+    stream.get(triangle, a, b, c);
+    return a == i && b == j && c == k;
+}
+
+TEST(ObjParsing, LineEndingsIndicesAndGroups) {
+    // CRLF line endings, relative indices, two materials and a quad on a last line without newline
+    std::string path = testFile("small.obj");
+    CHECK(writeTextFile(path,
+            "# test mesh\r\n"
+            "v 0 0 0\r\n"
+            "v 1 0 0\r\n"
+            "v 1 1 0\r\n"
+            "v 0 1 0\r\n"
+            "vt 0 0\r\n"
+            "vt 1 0\r\n"
+            "vt 1 1\r\n"
+            "vn 0 0 1\r\n"
+            "f 1/1/1 2/2/1 3/3/1\r\n"
+            "usemtl red\r\n"
+            "f -4//-1 -2//-1 -1//-1\r\n"
+            "usemtl blue\r\n"
+            "f 1 2 3 4"));
+    TriangleMesh mesh(Vector(1, 1, 1));
+    CHECK(mesh.readOBJ(path.c_str(), 1));
+    CHECK_EQUAL(mesh.vertices.size(), 4);
+    CHECK_EQUAL(mesh.uvs.size(), 3);
+    CHECK_EQUAL(mesh.normals.size(), 1);
+    CHECK(mesh.vertices[3][0] == 0 && mesh.vertices[3][1] == 1 && mesh.vertices[3][2] == 0);
+    CHECK_EQUAL(mesh.triangleCount(), 4);
+    if (mesh.triangleCount() != 4) return;
+
+    CHECK(hasIndices(mesh.positionIndices, 0, 0, 1, 2));
+    CHECK(hasIndices(mesh.positionIndices, 1, 0, 2, 3));
+    CHECK(hasIndices(mesh.positionIndices, 2, 0, 1, 2));
+    CHECK(hasIndices(mesh.positionIndices, 3, 0, 2, 3));
+    CHECK(hasIndices(mesh.uvIndices, 0, 0, 1, 2));
+    CHECK(hasIndices(mesh.uvIndices, 1, -1, -1, -1));
+    CHECK(hasIndices(mesh.normalIndices, 1, 0, 0, 0));
+    CHECK(hasIndices(mesh.normalIndices, 3, -1, -1, -1));
+    CHECK_EQUAL(mesh.groups[0], -1);
+    CHECK_EQUAL(mesh.groups[1], 0);
+    CHECK_EQUAL(mesh.groups[2], 1);
+    CHECK_EQUAL(mesh.groups[3], 1);
+    remove(path.c_str());
+}
+
+TEST(ObjParsing, LargePolygon) {
+    const int corners = 400;
+    std::string obj;
+    for (int i = 0; i < corners; i++) {
+        obj += "v " + std::to_string(i) + " " + std::to_string(i % 7) + " 0\n";
+    }
+    obj += "f";
+    for (int i = 1; i <= corners; i++) {
+        obj += " " + std::to_string(i);
+    }
+    obj += "\n";
+    std::string path = testFile("polygon.obj");
+    CHECK(writeTextFile(path, obj));
+    TriangleMesh mesh(Vector(1, 1, 1));
+    CHECK(mesh.readOBJ(path.c_str(), 1));
+    CHECK_EQUAL(mesh.triangleCount(), corners - 2);
+    if (mesh.triangleCount() != corners - 2) return;
+    // the polygon is split into the fan (0, k - 1, k)
+    bool fan = true;
+    for (int k = 2; k < corners; k++) {
+        fan = fan && hasIndices(mesh.positionIndices, k - 2, 0, k - 1, k);
+    }
+    CHECK(fan);
+    remove(path.c_str());
+}
+
+/**
+ * A file of several MB, so that it is split into one part per thread, with the features whose parsing
+ * depends on what came before: relative indices, materials, colors and polygons.
+ */
+static std::string largeObj() {
+    std::string obj;
+    int vertices = 0;
+    for (int block = 0; obj.size() < (8 << 20); block++) {
+        for (int i = 0; i < 8; i++) {
+            obj += "v " + std::to_string(block) + "." + std::to_string(i) + " " + std::to_string(i * 3) + " -"
+                   + std::to_string(block % 101) + " 0.5 0." + std::to_string(i) + " 1\r\n";
+            obj += "vt 0." + std::to_string(i) + " 0.25\r\n";
+            obj += "vn 0 " + std::to_string(i) + " 1\r\n";
+        }
+        vertices += 8;
+        if (block % 5 == 0) obj += "usemtl m" + std::to_string(block) + "\r\n";
+        obj += "f -8/-8/-8 -7/-7/-7 -6/-6/-6 -5/-5/-5\r\n";
+        obj += "f " + std::to_string(vertices - 3) + "//" + std::to_string(vertices - 3) + " "
+               + std::to_string(vertices - 2) + "//" + std::to_string(vertices - 2) + " -1//-1\r\n";
+        if (block % 997 == 0) {
+            obj += "f";
+            for (int i = 1; i <= std::min(vertices, 40); i++) obj += " -" + std::to_string(i);
+            obj += "\r\n";
+        }
+    }
+    // no newline after the last face
+    obj += "f 1 2 3";
+    return obj;
+}
+
+TEST(ObjParsing, SameResultForAnyNumberOfThreads) {
+    std::string path = testFile("large.obj");
+    CHECK(writeTextFile(path, largeObj()));
+    TriangleMesh reference(Vector(1, 1, 1));
+    CHECK(reference.readOBJ(path.c_str(), 1));
+    CHECK(reference.triangleCount() > 30000);
+    for (int threads : {2, 4, 7}) {
+        TriangleMesh mesh(Vector(1, 1, 1));
+        CHECK(mesh.readOBJ(path.c_str(), threads));
+        CHECK(sameVectors(mesh.vertices, reference.vertices));
+        CHECK(sameVectors(mesh.uvs, reference.uvs));
+        CHECK(sameVectors(mesh.normals, reference.normals));
+        CHECK(sameVectors(mesh.vertexcolors, reference.vertexcolors));
+        CHECK(sameStream(mesh.positionIndices, reference.positionIndices));
+        CHECK(sameStream(mesh.uvIndices, reference.uvIndices));
+        CHECK(sameStream(mesh.normalIndices, reference.normalIndices));
+        CHECK(mesh.groups == reference.groups);
+    }
+    remove(path.c_str());
+}
@@ -0,0 +1,54 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include "Test.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int testFailures = 0;
+
+// function-local so that tests can register from any translation unit during static initialisation
+static std::vector<TestCase*>& testCases() {
+    static std::vector<TestCase*> cases;
+    return cases;
+}
+
+TestCase::TestCase(const char* suite, const char* name, void (*run)()) : suite(suite), name(name), run(run) {
+    testCases().push_back(this);
+}
+
+std::string testFile(const char* name) {
+    return std::string("test_") + name;
+}
+
+bool writeTextFile(const std::string& path, const std::string& content) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool written = fwrite(content.data(), 1, content.size(), f) == content.size();
+    return fclose(f) == 0 && written;
+}
+
+/**
+ * Run the tests of the suites given as arguments, or all tests without arguments.
+ *
+ * @return 0 if every check passed
+ */
+int main(int argc, char** argv) {
+    int failedTests = 0, ranTests = 0;
+    for (TestCase* test : testCases()) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++) {
+            selected = selected || strcmp(argv[i], test->suite) == 0;
+        }
+        if (!selected) continue;
+        testFailures = 0;
+        test->run();
+        ranTests++;
+        if (testFailures > 0) failedTests++;
+        std::cout << (testFailures > 0 ? "FAILED " : "passed ") << test->suite << "." << test->name << std::endl;
+    }
+    std::cout << ranTests - failedTests << " of " << ranTests << " tests passed" << std::endl;
+    return failedTests > 0 || ranTests == 0 ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#ifndef HELLOWORLD_TEST_H
+#define HELLOWORLD_TEST_H
+
+#include <iostream>
+#include <string>
+
+/**
+ * Minimal test registry: every TEST registers itself in a suite, the test runner runs the suites named on
+ * its command line, or all of them.
+ */
+class TestCase {
+public:
+    TestCase(const char* suite, const char* name, void (*run)());
+
+    const char* suite;
+    const char* name;
+    void (*run)();
+};
+
+// number of failed checks of the test running at the moment
+extern int testFailures;
+
+// path of a scratch file named after the test, in the working directory of the runner
+std::string testFile(const char* name);
+
+// replace the content of a file, returns false if it could not be written
+bool writeTextFile(const std::string& path, const std::string& content);
+
+#define TEST(suite, name) \
+    static void suite##_##name(); \
+    static TestCase suite##_##name##Case(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+// a failed check is reported and counted, the test goes on
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            testFailures++; \
+        } \
+    } while (false)
+
+// both sides are evaluated once
+#define CHECK_EQUAL(a, b) \
+    do { \
+        const auto& checkedA = (a); \
+        const auto& checkedB = (b); \
+        if (!(checkedA == checkedB)) { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": CHECK_EQUAL(" #a ", " #b ") failed: " << checkedA << " != " << checkedB << std::endl; \
+            testFailures++; \
+        } \
+    } while (false)
+
+#endif //HELLOWORLD_TEST_H
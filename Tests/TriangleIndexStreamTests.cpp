@@ -0,0 +1,102 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <cmath>
+#include <vector>
+#include "Models/TriangleIndexStream.h"
+#include "Models/TriangleMesh.h"
+#include "Tests/Test.h"
+
+static bool hasIndices(const TriangleIndexStream& stream, size_t triangle, int i, int j, int k) {
+    int a, b, c;
+    stream.get(triangle, a, b, c);
+    return a == i && b == j && c == k;
+}
+
+TEST(TriangleIndexStream, LargestNarrowIndex) {
+    TriangleIndexStream stream;
+    stream.push_back(0, MaxNarrowIndex, -1);
+    stream.push_back(MaxNarrowIndex - 1, 1, 2);
+    stream.compact();
+    CHECK(stream.isNarrow);
+    CHECK_EQUAL(stream.memoryUsage(), 6 * sizeof(uint16_t));
+    CHECK(hasIndices(stream, 0, 0, MaxNarrowIndex, -1));
+    CHECK(hasIndices(stream, 1, MaxNarrowIndex - 1, 1, 2));
+
+    // setting a triangle switches back to 32-bit indices without changing the others
+    stream.set(1, 3, 4, 5);
+    CHECK(!stream.isNarrow);
+    CHECK(hasIndices(stream, 0, 0, MaxNarrowIndex, -1));
+    CHECK(hasIndices(stream, 1, 3, 4, 5));
+}
+
+TEST(TriangleIndexStream, FirstWideIndex) {
+    // 0xFFFF is the missing index of a narrow stream, so it has to stay 32-bit
+    TriangleIndexStream stream;
+    stream.push_back(0, MaxNarrowIndex + 1, -1);
+    stream.compact();
+    CHECK(!stream.isNarrow);
+    CHECK_EQUAL(stream.memoryUsage(), 3 * sizeof(int32_t));
+    CHECK(hasIndices(stream, 0, 0, MaxNarrowIndex + 1, -1));
+}
+
+TEST(TriangleIndexStream, PermuteInBothWidths) {
+    TriangleIndexStream narrow, wide;
+    for (int t = 0; t < 5; t++) {
+        narrow.push_back(3 * t, 3 * t + 1, t == 2 ? -1 : 3 * t + 2);
+    }
+    wide = narrow;
+    narrow.compact();
+    CHECK(narrow.isNarrow);
+    std::vector<int> order = {4, 2, 0};
+    narrow.permute(order);
+    wide.permute(order);
+    CHECK_EQUAL(narrow.size(), 3);
+    CHECK_EQUAL(wide.size(), 3);
+    for (size_t t = 0; t < order.size(); t++) {
+        int a, b, c;
+        wide.get(t, a, b, c);
+        CHECK(hasIndices(narrow, t, a, b, c));
+        CHECK(hasIndices(wide, t, 3 * order[t], 3 * order[t] + 1, order[t] == 2 ? -1 : 3 * order[t] + 2));
+    }
+}
+
+/**
+ * Strip of triangles along x whose last triangle uses the last vertex, so that the widest index of the
+ * mesh decides the width of its position indices.
+ */
+static void buildStrip(TriangleMesh& mesh, int numberOfVertices) {
+    for (int v = 0; v < numberOfVertices; v++) {
+        mesh.vertices.push_back(Vector(v / 2, v % 2, 0));
+    }
+    for (int v = 0; v + 2 < numberOfVertices; v += 2) {
+        mesh.positionIndices.push_back(v, v + 1, v + 2);
+    }
+    mesh.positionIndices.push_back(numberOfVertices - 3, numberOfVertices - 2, numberOfVertices - 1);
+    mesh.buildBVH();
+}
+
+/**
+ * @return true if a ray straight down at x hits the mesh at z = 0
+ */
+static bool hitsAt(TriangleMesh& mesh, double x) {
+    Vector P, N, pError;
+    double t;
+    return mesh.intersect(Ray(Vector(x, 0.25, 1), Vector(0, 0, -1)), P, N, pError, t) && std::abs(t - 1) < 1E-6;
+}
+
+TEST(TriangleIndexStream, MeshAtTheNarrowBoundary) {
+    TriangleMesh narrow(Vector(1, 1, 1)), wide(Vector(1, 1, 1));
+    buildStrip(narrow, MaxNarrowIndex + 1);
+    buildStrip(wide, MaxNarrowIndex + 2);
+    CHECK(narrow.positionIndices.isNarrow);
+    CHECK(!wide.positionIndices.isNarrow);
+    CHECK_EQUAL(narrow.indexMemory() * 2, wide.indexMemory());
+    // rays through the last quad of the strip, whose triangles use the largest index of each mesh
+    CHECK(hitsAt(narrow, (MaxNarrowIndex - 2) / 2 + 0.1));
+    CHECK(hitsAt(wide, (MaxNarrowIndex - 1) / 2 + 0.9));
+    CHECK(!hitsAt(narrow, (MaxNarrowIndex - 2) / 2 + 0.9));
+    CHECK(hitsAt(narrow, 0.1));
+    CHECK(hitsAt(wide, 0.1));
+}
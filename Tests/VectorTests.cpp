@@ -0,0 +1,80 @@
+//
+// Created by Martin Voigt on 17.10.26.
+//
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include "Models/Vector.h"
+#include "Tests/Test.h"
+
+/**
+ * @return largest component-wise distance of a and b relative to the largest component of b
+ */
+template<typename T>
+static double relativeError(const VectorT<T>& a, const VectorT<T>& b) {
+    double scale = std::max(std::abs((double) b[0]), std::max(std::abs((double) b[1]), std::abs((double) b[2])));
+    double error = 0;
+    for (int j = 0; j < 3; j++) {
+        error = std::max(error, std::abs((double) a[j] - (double) b[j]));
+    }
+    return error / scale;
+}
+
+/**
+ * getNormalizedFast may only differ from getNormalized by rounding, over many magnitudes.
+ */
+template<typename T>
+static void checkNormalizedFast(double tolerance) {
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> component(-1, 1), exponent(-20, 20);
+    double worst = 0;
+    for (int i = 0; i < 100000; i++) {
+        double scale = std::pow(2., exponent(generator));
+        VectorT<T> v((T) (scale * component(generator)), (T) (scale * component(generator)), (T) (scale * component(generator)));
+        if (v.sqrNorm() == 0) continue;
+        worst = std::max(worst, relativeError(v.getNormalizedFast(), v.getNormalized()));
+    }
+    CHECK(worst <= tolerance);
+}
+
+TEST(Vector, NormalizedFastFloat) {
+    checkNormalizedFast<float>(4 * std::numeric_limits<float>::epsilon());
+}
+
+TEST(Vector, NormalizedFastDouble) {
+    // the double version refines a single precision estimate to about 46 bits
+    checkNormalizedFast<double>(1E-12);
+}
+
+/**
+ * A fused multiply-add skips the rounding of the product, so it may only differ from a*u + C by that
+ * rounding and the rounding of the sum.
+ */
+template<typename T>
+static void checkMultiplyAdd() {
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<double> value(-100, 100);
+    const double epsilon = std::numeric_limits<T>::epsilon();
+    bool withinRounding = true;
+    for (int i = 0; i < 100000; i++) {
+        T a = (T) value(generator);
+        VectorT<T> u((T) value(generator), (T) value(generator), (T) value(generator));
+        VectorT<T> C((T) value(generator), (T) value(generator), (T) value(generator));
+        VectorT<T> fused = multiplyAdd(a, u, C);
+        VectorT<T> separate = a * u + C;
+        for (int j = 0; j < 3; j++) {
+            double bound = epsilon * (std::abs((double) a * u[j]) + std::abs((double) separate[j]));
+            withinRounding = withinRounding && std::abs((double) fused[j] - (double) separate[j]) <= bound;
+        }
+    }
+    CHECK(withinRounding);
+}
+
+TEST(Vector, MultiplyAddFloat) {
+    checkMultiplyAdd<float>();
+}
+
+TEST(Vector, MultiplyAddDouble) {
+    checkMultiplyAdd<double>();
+}
@@ -7,17 +7,19 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#include <random>
-static std::default_random_engine engine(10); // random seed = 10
-static std::uniform_real_distribution<double> uniform(0, 1);
-
 #include <algorithm>
+#include <chrono>
 #include "Models/Vector.h"
 #include "Models/Ray.h"
 #include "Models/Sphere.h"
+#include "Models/Plane.h"
+#include "Models/Quad.h"
 #include "Models/Scene.h"
 #include "Models/TriangleIndices.h"
 #include "Models/TriangleMesh.h"
+#include "Models/Instance.h"
+#include "Models/Renderer.h"
+#include "Models/WavefrontIntegrator.h"
 
 
 int main() {
@@ -39,92 +41,98 @@ int main() {
     Sphere S2(Vector(-10, 0, -20), 3, Vector(1., 0., 1.), true, false);
     Sphere S3(Vector(10, 0, 20), 5, Vector(1., 0., 1.));
 
-    Sphere floor(Vector(0, -1000, 0), 990, Vector(1., 1., 1.));
-    Sphere leftWall(Vector(-1000, 0, 0), 940, Vector(1., 0., 0.));
-    Sphere rightWall(Vector(1000, 0, 0), 940, Vector(0., 1., 0.));
-    Sphere backgroundWall(Vector(0, 0, -1000), 940, Vector(0., 0.5, 0.5));
-    Sphere frontWall(Vector(0, 0, 1000), 940, Vector(1., 1., 0.));
-    Sphere ceiling(Vector(0, 1000, 0), 940, Vector(1., 1., 1.));
+    // the room spans x and z in [-60, 60] and y in [-10, 60], all walls face inwards, the walls close the floor plane off
+    Plane floor(Vector(0, -10, 0), Vector(0, 1, 0), Vector(1., 1., 1.));
+    Quad leftWall(Vector(-60, -10, -60), Vector(-60, 60, 60), Vector(1, 0, 0), Vector(1., 0., 0.));
+    Quad rightWall(Vector(60, -10, -60), Vector(60, 60, 60), Vector(-1, 0, 0), Vector(0., 1., 0.));
+    Quad backgroundWall(Vector(-60, -10, -60), Vector(60, 60, -60), Vector(0, 0, 1), Vector(0., 0.5, 0.5));
+    Quad frontWall(Vector(-60, -10, 60), Vector(60, 60, 60), Vector(0, 0, -1), Vector(1., 1., 0.));
+    Quad ceiling(Vector(-60, 60, -60), Vector(60, 60, 60), Vector(0, -1, 0), Vector(1., 1., 1.));
 
 
     TriangleMesh m(Vector(1., 1., 1.));
 
-    m.readOBJ("/Users/martin/CLionProjects/raytracer/dog.obj");
-
-    for (int i = 0; i <m.vertices.size(); i++) {
-        std::swap(m.vertices[i][1], m.vertices[i][2]);
-        m.vertices[i][2] = -m.vertices[i][2];
-        m.vertices[i][2] += 10;
-        m.vertices[i][1] -= 10;
+    const char* dogPath = "/Users/martin/CLionProjects/raytracer/dog.obj";
+    // parsed mesh and BVH, rebuilt whenever the OBJ file or the BVH settings change
+    const char* dogCachePath = "dog.meshcache";
+    m.bvhSettings.splitMethod = SAHSplit;
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!m.loadOBJ(dogPath, dogCachePath)) {
+        std::cout << "could not read " << dogPath << std::endl;
     }
-    for (int i = 0; i <m.normals.size(); i++) {
-        std::swap(m.normals[i][1], m.normals[i][2]);
+    std::cout << "OBJ: " << m.vertices.size() << " vertices, " << m.triangleCount() << " triangles, loaded in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count() << "s" << std::endl;
+    std::cout << "optimized: " << m.optimizerStatistics.weldedVertices << " vertices welded, "
+              << m.optimizerStatistics.degenerateTriangles << " degenerate triangles and "
+              << m.optimizerStatistics.unusedVertices << " unused vertices removed in " << m.optimizerStatistics.time << "s" << std::endl;
+    if (m.triangleCount() > 0) {
+        // compared to one TriangleIndices per triangle
+        double indexBytes = (double) m.indexMemory() / m.triangleCount();
+        std::cout << "indices: " << indexBytes << " bytes per triangle (" << (m.positionIndices.isNarrow ? 16 : 32)
+                  << "-bit positions), " << (sizeof(TriangleIndices) - indexBytes) << " MB saved per million triangles" << std::endl;
     }
-
-    // m.buildBB();
-    m.buildBVH(m.BVH, 0, m.indices.size());
-
-
-    scene.objects.push_back(&lightBall);
-    scene.objects.push_back(&S1);
-    scene.objects.push_back(&S2);
-    scene.objects.push_back(&S3);
-    scene.objects.push_back(&floor);
-    scene.objects.push_back(&leftWall);
-    scene.objects.push_back(&rightWall);
-    scene.objects.push_back(&backgroundWall);
-    scene.objects.push_back(&frontWall);
-    scene.objects.push_back(&ceiling);
-    // scene.objects.push_back(&m);
-
+    std::cout << "BVH: " << m.bvhStatistics.numberOfNodes << " nodes, " << m.bvhStatistics.numberOfLeaves
+              << " leaves, depth " << m.bvhStatistics.maxDepth << ", SAH cost " << m.bvhStatistics.sahCost
+              << ", built in " << m.bvhStatistics.buildTime << "s ("
+              << m.bvhStatistics.primitivesPerSecond / 1E6 << " M triangles/s)" << std::endl;
+
+    // the dog is modelled z-up, stand it on the floor: (x, y, z) -> (x, z - 10, 10 - y)
+    Instance dog(&m, Transform(Vector(1, 0, 0), Vector(0, 0, -1), Vector(0, 1, 0), Vector(0, -10, 10)), Vector(1., 1., 1.));
+
+
+    scene.addObject(&lightBall);
+    scene.addObject(&S1);
+    scene.addObject(&S2);
+    scene.addObject(&S3);
+    scene.addObject(&floor);
+    scene.addObject(&leftWall);
+    scene.addObject(&rightWall);
+    scene.addObject(&backgroundWall);
+    scene.addObject(&frontWall);
+    scene.addObject(&ceiling);
+    // scene.addObject(&dog);
+
+    Renderer renderer(scene, W, H);
+    // camera position
+    renderer.C = C;
     // camera angle in rad
-    double fov = 60*M_PI/180;
-
-    int numberOfRays = 100;
-
-    std::vector<unsigned char> image(W*H * 3, 0);
-
-    int counter = 0;
-
-    for (int i = 0; i < H; i++) {
-        for (int j = 0; j < W; j++) {
-            Vector color(0, 0, 0);
-            for (int k = 0; k < numberOfRays; k++) {
-                double u1 = uniform(engine);
-                double u2 = uniform(engine);
-                double x1 = 0.25*cos(2*M_PI*u1)*sqrt(-2 * log(u2));
-                double x2 = 0.25*sin(2*M_PI*u1)*sqrt(-2 * log(u2));
-                u1 = uniform(engine);
-                u2 = uniform(engine);
-                double x3 = 0.01*cos(2*M_PI*u1)*sqrt(-2 * log(u2));
-                double x4 = 0.01*sin(2*M_PI*u1)*sqrt(-2 * log(u2));
-
-                // create ray from pixel coordinates
-                Vector u(j - W/2 + x2 + 0.5, i - H/2 + x1 + 0.5, -W/(2.*tan(fov/2)));
-                u = u.getNormalized();
-                Vector target = C + 55 * u;
-                Vector Cprim = C + Vector(x3, x4, 0);
-                Vector uprime = (target - Cprim).getNormalized();
-
-                Ray r(Cprim, uprime);
-
-                color += scene.getColor(r, 0, false);
-            }
-            color = color/numberOfRays;
-
-            // gamma correction
-            double gamma = 2.2;
-
-            image[((H - i - 1)*W + j)* 3 + 0] = std::min(255.0, pow(color[0], 1/gamma));
-            image[((H - i - 1)*W + j)* 3 + 1] = std::min(255.0, pow(color[1], 1/gamma));
-            image[((H - i - 1)*W + j)* 3 + 2] = std::min(255.0, pow(color[2], 1/gamma));
-
-            if (counter % 1000 == 0) {
-                std::cout << counter << " / " << H*W << std::endl;
+    renderer.fov = 60*M_PI/180;
+    renderer.numberOfRays = 100;
+
+    // trace all paths bounce by bounce instead of one after another
+    bool wavefront = false;
+    // also trace every wavefront batch unsorted to measure what sorting the bounce rays saves, doubles the extend work
+    bool compareSortedExtend = false;
+
+    std::vector<unsigned char> image;
+    if (wavefront) {
+        WavefrontIntegrator integrator(renderer);
+        integrator.compareUnsortedExtend = compareSortedExtend;
+        integrator.render(image);
+        std::cout << "generate " << integrator.generateTime << "s, sort " << integrator.sortTime
+                  << "s, extend " << integrator.extendTime << "s, shade " << integrator.shadeTime
+                  << "s, connect " << integrator.connectTime << "s, regenerate " << integrator.regenerateTime << "s" << std::endl;
+        if (integrator.sortTime + integrator.extendTime > 0) {
+            std::cout << integrator.extendedRays / (integrator.sortTime + integrator.extendTime) / 1E6
+                      << " M rays/s including the sort" << std::endl;
+        }
+        // only bounce rays are traced unsorted, a render may have none
+        if (integrator.compareUnsortedExtend && integrator.sortSecondaryRays
+                && integrator.unsortedExtendTime > 0 && integrator.extendedRays > 0) {
+            std::cout << integrator.extendedRays / integrator.unsortedExtendTime / 1E6 << " M rays/s unsorted" << std::endl;
+            if (integrator.extendCacheMisses >= 0 && integrator.unsortedExtendCacheMisses >= 0) {
+                double rays = (double) integrator.extendedRays;
+                std::cout << "extend cache misses: " << integrator.extendCacheMisses / rays << " per ray sorted, "
+                          << integrator.unsortedExtendCacheMisses / rays << " per ray unsorted, ratio "
+                          << (double) integrator.extendCacheMisses / std::max(1LL, integrator.unsortedExtendCacheMisses) << std::endl;
+            } else {
+                std::cout << "extend cache misses: hardware counter not available" << std::endl;
             }
-            counter++;
         }
+    } else {
+        renderer.render(image);
     }
+
     stbi_write_png("image9_dog.png", W, H, 3, &image[0], 0);
 
     return 0;